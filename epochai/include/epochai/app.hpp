@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace epochai {
@@ -15,6 +16,20 @@ namespace epochai {
 /// from `main`. The `state_directory` constructor argument must point to a
 /// writable location on disk where state and logs are stored.
 
+/// Optional behaviour selected on the command line.
+struct ApplicationOptions {
+    /// Score the dataset against the persisted model without training or
+    /// contacting remote services. Model, journal and token cache files are
+    /// only read, so several evaluators may share a state directory with a
+    /// training process; besides `events.log`, only a missing default config
+    /// or dataset is ever created. Pending journal records are replayed in
+    /// memory, which materializes the model; otherwise its image is mapped.
+    bool evaluate_only = false;
+    /// Training steps to run with the model held in memory; 0 runs until
+    /// SIGINT or SIGTERM. Values other than 1 select daemon mode.
+    std::size_t steps = 1;
+};
+
 /// Executes the primary EpochAI workflow.
 ///
 /// The `Application` owns the lifecycle of the state directory provided at
@@ -23,7 +38,7 @@ namespace epochai {
 class Application {
 public:
     /// Create an application that persists all files beneath `state_directory`.
-    explicit Application(std::string state_directory = "state");
+    explicit Application(std::string state_directory = "state", ApplicationOptions options = {});
 
     /// Start the training/evaluation loop.
     ///
@@ -33,6 +48,7 @@ public:
 
 private:
     std::string state_directory_;
+    ApplicationOptions options_;
 };
 
 }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "epochai/model_journal.hpp"
+#include "epochai/state.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace epochai {
+
+/// \file checkpoint_writer.hpp
+/// Background checkpointing for the training loop.
+///
+/// The training thread freezes what a step changed into a `ModelDelta`, an
+/// immutable value whose size is proportional to the change rather than to the
+/// model, and hands it to `CheckpointWriter`. A dedicated thread appends it to
+/// the journal, fsyncs, and starts journal compaction when due, so neither
+/// serialization nor disk latency sits on the training path.
+
+/// Outcome of one background checkpoint.
+struct CheckpointReport {
+    std::int64_t step = 0;
+    /// Journal size after the append.
+    std::uintmax_t journal_bytes = 0;
+    /// Time spent writing and syncing on the checkpoint thread.
+    std::chrono::milliseconds latency{0};
+    /// Whether the append triggered a background compaction.
+    bool compaction_started = false;
+};
+
+/// Single-slot asynchronous checkpoint queue.
+class CheckpointWriter {
+public:
+    /// Checkpoint through `manager`, compacting once the journal reaches
+    /// `compact_threshold_bytes`.
+    CheckpointWriter(StateManager& manager, std::uintmax_t compact_threshold_bytes);
+
+    /// Finishes queued work and stops the thread; failures are discarded.
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    /// Queue `delta` for writing. At most one checkpoint is in flight: this
+    /// blocks while the previous one is still being written. The future
+    /// carries the report, or the exception that failed the write.
+    std::future<CheckpointReport> submit(ModelDelta delta);
+
+    /// Wait until every submitted checkpoint and any compaction it started
+    /// have finished, rethrowing a compaction failure. Must not race `submit`.
+    void drain();
+
+private:
+    struct Job {
+        ModelDelta delta;
+        std::promise<CheckpointReport> promise;
+    };
+
+    void run();
+    CheckpointReport write(const ModelDelta& delta);
+
+    StateManager& manager_;
+    std::uintmax_t compact_threshold_bytes_;
+    JournalCompactor compactor_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::optional<Job> pending_;
+    bool busy_ = false;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "epochai/worker_pool.hpp"
+
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -11,25 +14,76 @@ namespace epochai {
 ///
 /// Functions in this header accept raw text inputs and derive aggregate
 /// statistics about tokenization and lexical structure. The invariants around
-/// the returned metrics are intentionally simple: lengths are non-negative,
-/// `letters_per_word.size()` matches `word_count`, and `tokens` mirrors the
-/// tokenizer output size.
+/// the returned metrics are intentionally simple: counts are 64-bit so that
+/// multi-gigabyte corpora cannot overflow them, `tokens` mirrors the
+/// tokenizer output size and, when words are recorded,
+/// `letters_per_word.size()` matches `word_count`.
+///
+/// Counting classifies each byte once with the tokenizer's "C" locale
+/// character classes instead of materializing tokens, so the aggregate
+/// counters cost no allocations. Recording `words` and `letters_per_word` is
+/// opt-in.
 
 /// Aggregated lexical statistics generated from `count_metrics`.
 struct CountMetrics {
-    int tokens = 0;
-    int word_count = 0;
-    int total_letters = 0;
-    std::vector<int> letters_per_word;
+    std::uint64_t tokens = 0;
+    std::uint64_t word_count = 0;
+    std::uint64_t total_letters = 0;
+    std::vector<std::uint64_t> letters_per_word;
     std::vector<std::string> words;
+
+    /// Append the metrics of text that directly follows the text counted so
+    /// far, separated from it by whitespace. Merging is associative, and
+    /// recorded words keep their input order.
+    void merge(CountMetrics&& other);
 };
 
 /// Count lexical metrics for an arbitrary UTF-8 text buffer.
 ///
 /// @param text The raw user text to analyze. The function does not take
 ///             ownership of the buffer.
+/// @param record_words Also fill `words` and `letters_per_word`.
 /// @returns A `CountMetrics` structure satisfying the invariants documented
 ///          above.
-CountMetrics count_metrics(std::string_view text);
+CountMetrics count_metrics(std::string_view text, bool record_words = false);
+
+/// Parallel `count_metrics`: `text` is cut at whitespace into pieces that are
+/// counted on `pool` and merged in input order, so the result equals the
+/// serial one exactly.
+CountMetrics count_metrics(std::string_view text, WorkerPool& pool, bool record_words = false);
+
+/// Streaming form of `count_metrics` for text that arrives in pieces.
+///
+/// Chunks may split a word anywhere; feeding a buffer piecewise yields the
+/// same metrics as one `count_metrics` call over the whole buffer. Without
+/// `record_words` the counter never allocates.
+class MetricsCounter {
+public:
+    explicit MetricsCounter(bool record_words = false) noexcept
+        : record_words_(record_words) {}
+
+    /// Count `chunk`, continuing a word left open by the previous chunk.
+    void feed(std::string_view chunk);
+
+    /// Same as `feed`, counting the whitespace-delimited middle of a large
+    /// chunk on `pool`. Uses the pool's `parallel_for`, so it must not be
+    /// called from inside another job on the same pool.
+    void feed(std::string_view chunk, WorkerPool& pool);
+
+    /// Close the trailing word and return the metrics gathered so far. The
+    /// counter starts over afterwards.
+    CountMetrics finish();
+
+private:
+    void feed_recording(std::string_view chunk);
+    void close_word();
+
+    CountMetrics metrics_;
+    bool record_words_;
+    bool in_word_ = false;
+    bool all_letters_ = true;
+    std::uint64_t letters_ = 0;
+    std::string word_;
+};
 
 }
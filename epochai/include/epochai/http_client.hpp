@@ -1,6 +1,9 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
+#include <future>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -8,13 +11,35 @@
 namespace epochai {
 
 /// \file http_client.hpp
-/// Lightweight synchronous HTTP client responsible for communicating with
+/// Lightweight asynchronous HTTP client responsible for communicating with
 /// external services such as MCP and LM Studio.
 ///
+/// Every request runs on one event-loop thread owned by the client, which
+/// multiplexes all sockets over non-blocking I/O (epoll on Linux), so any
+/// number of requests can be in flight at once and callers wait only for the
+/// ones they need.
+///
+/// New connections race the resolved addresses Happy Eyeballs style (RFC 8305):
+/// families alternate, each attempt gets a short head start before the next
+/// one begins, a failed attempt hands over immediately and the first
+/// established connection wins.
+///
+/// Failed attempts are retried after an exponential, jittered backoff, never
+/// past the request's overall deadline. Each `host:port` has a circuit
+/// breaker: after repeated failures it opens and fails requests immediately,
+/// then lets a single probe through to test for recovery.
+///
+/// Name lookups are cached per `host:port` for a bounded time, failures
+/// included, so steady-state requests never wait on the resolver; a
+/// connection failure drops the entry so the next attempt looks the name up
+/// again.
+///
 /// Requests are immutable after creation, and response metadata remains valid
-/// for the lifetime of the returned `HttpResult`. No persistent network
-/// connections are kept across calls; each invocation of `perform` starts a
-/// fresh request cycle.
+/// for the lifetime of the returned `HttpResult`. Connections are persistent
+/// HTTP/1.1 connections pooled per `host:port`: a response framed by
+/// `Content-Length` or chunked transfer coding leaves its socket ready for the
+/// next request, so back-to-back calls to one endpoint pay for a single
+/// handshake.
 
 /// Plain-old-data request description used by `HttpClient`.
 struct HttpRequest {
@@ -27,33 +52,115 @@ struct HttpRequest {
 /// Resulting HTTP payload and metadata.
 struct HttpResponse {
     int status = 0;
+    /// Decoded body, with any chunked transfer coding removed.
     std::string body;
     std::string headers;
 };
 
+/// State of the circuit breaker guarding one endpoint.
+enum class CircuitState {
+    /// Requests flow normally.
+    closed,
+    /// Too many consecutive failures: requests fail fast until the cool-down
+    /// ends.
+    open,
+    /// Cool-down over: one probe request decides whether to close again.
+    half_open,
+};
+
+/// Lowercase name of `state` for logs: "closed", "open" or "half_open".
+std::string_view circuit_state_name(CircuitState state) noexcept;
+
 /// Top-level result of a request, including error context and latency.
 struct HttpResult {
     bool success = false;
     HttpResponse response;
     std::string error_message;
+    /// Duration of the final attempt.
     std::chrono::milliseconds latency{0};
+    /// Attempts made, 0 when the request failed before any was started.
+    int attempts = 0;
+    /// State of the endpoint's circuit breaker when the request finished.
+    CircuitState circuit = CircuitState::closed;
 };
 
-/// Synchronous HTTP transport with retry logic.
+/// Connection pool, name cache, retry and circuit breaker policy of an
+/// `HttpClient`.
+struct HttpClientOptions {
+    /// Most connections open to one `host:port` at a time, busy or idle. A
+    /// request that finds them all busy waits for one within its timeout.
+    std::size_t max_connections_per_host = 4;
+    /// Idle connections unused for this long are closed.
+    std::chrono::milliseconds idle_timeout{30000};
+    /// Head start each connection attempt gets before the next resolved
+    /// address joins the race (RFC 8305 "Connection Attempt Delay").
+    std::chrono::milliseconds connection_attempt_delay{250};
+    /// How long resolved addresses of a host are reused before it is looked
+    /// up again, and how long a failed lookup is remembered. Zero disables
+    /// the respective caching.
+    std::chrono::milliseconds dns_ttl{60000};
+    std::chrono::milliseconds dns_negative_ttl{5000};
+    /// Backoff before the first retry; it doubles with every further retry
+    /// up to `retry_backoff_max`. The actual pause is drawn uniformly from
+    /// zero to the backoff ("full jitter") so retries from many requests do
+    /// not arrive in lockstep.
+    std::chrono::milliseconds retry_backoff_initial{100};
+    std::chrono::milliseconds retry_backoff_max{2000};
+    /// Consecutive failed attempts against one endpoint that open its
+    /// circuit. Transport errors and 5xx responses count as failures.
+    int circuit_failure_threshold = 5;
+    /// How long an open circuit fails requests fast before half-opening.
+    std::chrono::milliseconds circuit_open_duration{10000};
+};
+
+/// Asynchronous HTTP transport with retry logic and connection reuse.
+///
+/// `perform_async` and `perform` may be called from any thread.
 class HttpClient {
 public:
-    HttpClient();
+    /// Start the event-loop thread. Throws `std::system_error` when the
+    /// poller cannot be created.
+    explicit HttpClient(HttpClientOptions options = {});
+
+    /// Fails requests still in flight, closes every pooled connection and
+    /// stops the event loop.
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
 
-    /// Perform an HTTP request with bounded timeout and retries.
+    /// Start an HTTP request with bounded timeout and retries and return
+    /// without waiting for it.
     ///
-    /// @param request Immutable request description to send.
-    /// @param timeout_ms Per-attempt timeout in milliseconds.
+    /// Transport failures and 408, 429 and 5xx responses are retried; other
+    /// responses are final. A pooled connection that turns out to have been
+    /// closed by the server before it answered is replaced by a fresh one
+    /// without consuming a retry. While the endpoint's circuit is open the
+    /// request fails at once with "Circuit open"; a retry the circuit refuses
+    /// ends the request with the previous attempt's result instead.
+    ///
+    /// @param request Request description to send.
+    /// @param timeout_ms Per-attempt timeout in milliseconds. It bounds name
+    ///                   resolution and connection establishment together,
+    ///                   and then each wait for the server while sending or
+    ///                   receiving.
     /// @param retries Number of retry attempts allowed after the first try.
-    /// @returns A populated `HttpResult` describing success or failure.
-    HttpResult perform(const HttpRequest& request, int timeout_ms, int retries) const;
+    /// @param deadline_ms Overall budget in milliseconds for all attempts and
+    ///                    the backoff between them; 0 leaves the request
+    ///                    bounded only per attempt. A retry whose backoff
+    ///                    would end past the deadline is not started.
+    /// @returns A future that becomes ready with the populated `HttpResult`;
+    ///          failures are reported in the result, never as exceptions.
+    std::future<HttpResult> perform_async(HttpRequest request, int timeout_ms, int retries,
+                                          int deadline_ms = 0) const;
+
+    /// Blocking form of `perform_async`.
+    HttpResult perform(const HttpRequest& request, int timeout_ms, int retries, int deadline_ms = 0) const;
 
 private:
-    HttpResult perform_once(const HttpRequest& request, int timeout_ms) const;
+    class EventLoop;
+
+    std::unique_ptr<EventLoop> loop_;
 };
 
 }
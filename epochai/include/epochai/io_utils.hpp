@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <optional>
@@ -32,10 +33,106 @@ public:
     static std::optional<std::string> try_read_file(const std::filesystem::path& path);
 };
 
+/// Streams a file too large to buffer to `<path>.tmp` and atomically renames
+/// it into place on `commit`, with the same guarantees as
+/// `FileIO::atomic_write`. A writer destroyed before `commit` removes the
+/// temporary file and leaves `path` untouched.
+class AtomicFileWriter {
+public:
+    /// Create or truncate `<path>.tmp`. Throws `std::system_error` on failure.
+    explicit AtomicFileWriter(std::filesystem::path path);
+    ~AtomicFileWriter();
+
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    /// Append `data` at the end of the file.
+    void append(std::string_view data);
+
+    /// Overwrite bytes already appended, starting at `offset`.
+    void write_at(std::uint64_t offset, std::string_view data);
+
+    /// Bytes appended so far.
+    std::uint64_t size() const noexcept { return size_; }
+
+    /// Fsync the file and rename it over `path`.
+    void commit();
+
+private:
+    std::filesystem::path path_;
+    std::string temp_path_;
+    int fd_ = -1;
+    std::uint64_t size_ = 0;
+};
+
+/// Read-only memory mapping of an entire file.
+///
+/// Pages are faulted in on first access, so opening a large file costs the
+/// same as opening a small one. On POSIX the mapping stays valid for the
+/// lifetime of the object even if the file is atomically replaced on disk;
+/// Windows refuses to replace a mapped file. Empty files map to an empty view.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    /// Map `path`. Throws `std::system_error` when it cannot be opened.
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Mapped contents; page-aligned when non-empty.
+    std::string_view bytes() const noexcept { return {data_, size_}; }
+
+private:
+    void reset() noexcept;
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
+
 /// Format the current UTC timestamp in ISO-8601 form.
 std::string format_utc_timestamp();
 
 /// Convert an integer to a zero-padded hexadecimal string.
 std::string to_hex(std::uint64_t value);
 
+/// `ContentHasher` digest of zero bytes with the default seed.
+inline constexpr std::uint64_t kEmptyContentHash = 0xef46db3751d8e999ULL;
+
+/// Streaming 64-bit content hash (XXH64).
+///
+/// The digest depends only on the seed and the bytes fed, never on how they
+/// were split across `update` calls or on the build and platform, so digests
+/// logged on different hosts can be compared. Input is consumed in 32-byte
+/// stripes by four independent lanes, which makes it several times faster
+/// than a byte-serial hash such as FNV-1a on large inputs. The hasher is a
+/// small value type: copying it forks the stream.
+class ContentHasher {
+public:
+    explicit ContentHasher(std::uint64_t seed = 0) noexcept;
+
+    /// Feed the next bytes of the stream.
+    void update(std::string_view data) noexcept;
+
+    /// Digest of everything fed so far; the stream may continue afterwards.
+    std::uint64_t digest() const noexcept;
+
+private:
+    std::uint64_t lanes_[4];
+    std::uint64_t seed_;
+    std::uint64_t length_ = 0;
+    unsigned char stripe_[32];
+    std::size_t buffered_ = 0;
+};
+
+/// One-shot `ContentHasher` digest of `data`.
+std::uint64_t content_hash(std::string_view data) noexcept;
+
 }
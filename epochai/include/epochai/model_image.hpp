@@ -0,0 +1,135 @@
+#pragma once
+
+#include "epochai/io_utils.hpp"
+#include "epochai/state.hpp"
+#include "epochai/vocabulary.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace epochai {
+
+/// \file model_image.hpp
+/// Versioned binary encoding of `ModelState`.
+///
+/// An image is a 64-byte `ModelImageHeader` followed by fixed-width sections,
+/// each starting on an 8-byte boundary:
+///
+/// | Section         | Type                    | Length            |
+/// |-----------------|-------------------------|-------------------|
+/// | `vocab_offsets` | `uint64_t`              | `vocab_size + 1`  |
+/// | `token_index`   | `TokenId`               | `vocab_size`      |
+/// | `row_offsets`   | `uint64_t`              | `vocab_size + 1`  |
+/// | `next_ids`      | `TokenId`               | `transition_count`|
+/// | `counts`        | `double`                | `transition_count`|
+/// | `totals`        | `double`                | `vocab_size`      |
+/// | `strings`       | bytes                   | `string_bytes`    |
+///
+/// Token `i` is `strings[vocab_offsets[i], vocab_offsets[i + 1])`;
+/// `token_index` lists ids in byte-wise string order for lookups. Transitions
+/// are stored row by row in `(prev, next)` order: row `prev` spans
+/// `[row_offsets[prev], row_offsets[prev + 1])` of `next_ids` / `counts`.
+/// `totals` is dense, with 0 for empty rows. Values are stored as native
+/// little-endian integers and IEEE doubles, so counts round-trip exactly and
+/// an image can be used in place without parsing.
+///
+/// `checksum` is the `ContentHasher` digest of the whole image with the
+/// checksum field zeroed.
+
+/// Format revision written by `encode_model_image`.
+inline constexpr std::uint32_t kModelImageVersion = 1;
+
+/// Fixed-size leading block of a model image.
+struct ModelImageHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::int64_t step;
+    std::uint64_t vocab_size;
+    std::uint64_t transition_count;
+    std::uint64_t string_bytes;
+    std::uint64_t checksum;
+    std::uint64_t reserved;
+};
+static_assert(sizeof(ModelImageHeader) == 64);
+
+/// Typed, bounds-checked views over the sections of an image. The spans point
+/// into the buffer passed to `parse_model_image` and share its lifetime.
+struct ModelImageView {
+    std::int64_t step = 0;
+    std::span<const std::uint64_t> vocab_offsets;
+    std::span<const TokenId> token_index;
+    std::span<const std::uint64_t> row_offsets;
+    std::span<const TokenId> next_ids;
+    std::span<const double> counts;
+    std::span<const double> totals;
+    std::string_view strings;
+
+    std::size_t vocab_size() const noexcept { return totals.size(); }
+
+    /// String of token `id`; `id` must be below `vocab_size()`.
+    std::string_view token(TokenId id) const noexcept {
+        return strings.substr(vocab_offsets[id], vocab_offsets[id + 1] - vocab_offsets[id]);
+    }
+};
+
+/// How much of an image `parse_model_image` inspects.
+enum class ModelImageCheck {
+    /// Header, version and section sizes only; touches the first page.
+    header,
+    /// Additionally the checksum, offset monotonicity and token id ranges;
+    /// reads the whole image.
+    full,
+};
+
+/// Serialize `state` into a binary image.
+std::string encode_model_image(const ModelState& state);
+
+/// Validate `image` and return views over its sections. `image` must start on
+/// an 8-byte boundary. Throws `std::runtime_error` when a check selected by
+/// `check` fails.
+ModelImageView parse_model_image(std::string_view image, ModelImageCheck check = ModelImageCheck::full);
+
+/// Materialize a mutable `ModelState` from an encoded image.
+ModelState decode_model_image(std::string_view image);
+
+/// Read-only model served directly from a memory-mapped image.
+///
+/// Opening validates only the header, so startup cost does not depend on
+/// model size; vocabulary and transition pages fault in as lookups
+/// touch them. Token lookup is a binary search over `token_index` and
+/// `count` a binary search within one transition row. Lookups clamp every
+/// offset to the image bounds, so an unverified image can yield wrong values
+/// but never out-of-bounds reads.
+class MappedModel {
+public:
+    explicit MappedModel(const std::filesystem::path& path);
+
+    std::int64_t step() const noexcept { return view_.step; }
+    std::size_t vocab_size() const noexcept { return view_.vocab_size(); }
+
+    /// Id of `token` in the image, if present.
+    std::optional<TokenId> find(std::string_view token) const noexcept;
+
+    /// String of token `id`, or empty when `id` is out of range.
+    std::string_view token(TokenId id) const noexcept;
+
+    /// Count recorded for `prev -> next`, or 0 when absent.
+    double count(TokenId prev, TokenId next) const noexcept;
+
+    /// Row total for `prev`, or 0 when the row is empty.
+    double total(TokenId prev) const noexcept;
+
+    const ModelImageView& view() const noexcept { return view_; }
+
+private:
+    MappedFile file_;
+    ModelImageView view_;
+};
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "epochai/state.hpp"
+#include "epochai/transition_table.hpp"
+#include "epochai/vocabulary.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace epochai {
+
+/// \file model_journal.hpp
+/// Append-only checkpoint journal layered over the binary model snapshot.
+///
+/// Each training step appends one record holding only what the step changed:
+/// the tokens it interned, `(prev, next, delta)` transition records and the
+/// new totals of the rows it touched. Checkpoint I/O therefore scales with
+/// the size of the change instead of the model. Recovery loads the snapshot
+/// and replays every record newer than its step. Records live in numbered
+/// segment files; `JournalCompactor` seals the active segment and folds the
+/// sealed ones into a new snapshot on a background thread while training
+/// keeps appending to a fresh segment.
+///
+/// Each record is a 64-byte header (magic, step, section counts, payload
+/// size, `content_hash` of the payload) followed by the payload. A record cut
+/// short by a crash at the end of the newest segment is discarded on replay.
+
+/// Everything one training step changed in a `ModelState`.
+struct ModelDelta {
+    std::int64_t step = 0;
+    /// Vocabulary size before the step; `new_tokens` take the following ids.
+    std::size_t first_new_token = 0;
+    std::vector<std::string> new_tokens;
+    /// Count deltas in `(prev, next)` order.
+    std::vector<TransitionTable::Entry> transitions;
+    /// Row totals after the step for every row in `transitions`.
+    std::vector<std::pair<TokenId, double>> totals;
+};
+
+/// Describe the step that just applied `applied` to `state`, where
+/// `first_new_token` was the vocabulary size when the model was loaded.
+ModelDelta make_model_delta(const ModelState& state, std::size_t first_new_token, const TransitionCounts& applied);
+
+/// Numbered journal segments inside one directory.
+class ModelJournal {
+public:
+    explicit ModelJournal(std::filesystem::path directory);
+
+    /// Append `delta` to the newest segment and fsync it.
+    void append(const ModelDelta& delta);
+
+    /// Existing segments, oldest first.
+    std::vector<std::filesystem::path> segments() const;
+
+    /// Total size of all segments in bytes.
+    std::uintmax_t size_bytes() const;
+
+    /// Start a new empty segment so later appends leave the current ones
+    /// untouched, and return the segments that were sealed.
+    std::vector<std::filesystem::path> seal();
+
+    /// Apply the records of `segments` whose step is newer than `state.step`.
+    /// A torn record at the end of the last segment ends the replay and, with
+    /// `repair`, is truncated away; any other malformed record throws
+    /// `std::runtime_error`. Readers that do not own the journal pass
+    /// `repair = false`, since the tail may be an append still in progress.
+    /// Returns the number of records applied.
+    std::size_t replay(ModelState& state, const std::vector<std::filesystem::path>& segments,
+                       bool repair = true) const;
+
+private:
+    std::filesystem::path directory_;
+};
+
+/// Runs journal compaction for a `StateManager` on a background thread.
+class JournalCompactor {
+public:
+    explicit JournalCompactor(StateManager& manager);
+
+    /// Waits for a running compaction; failures are discarded, call `wait`
+    /// to observe them.
+    ~JournalCompactor();
+
+    JournalCompactor(const JournalCompactor&) = delete;
+    JournalCompactor& operator=(const JournalCompactor&) = delete;
+
+    /// Seal the journal and fold it into a new snapshot in the background
+    /// when it holds at least `threshold_bytes` (and is not empty) and no
+    /// compaction is running. A finished compaction is reaped first and its
+    /// failure rethrown. Returns whether a compaction was started.
+    bool start_if_due(std::uintmax_t threshold_bytes);
+
+    /// Block until the running compaction, if any, finishes, rethrowing its
+    /// failure. Returns whether there was one to wait for.
+    bool wait();
+
+private:
+    StateManager& manager_;
+    std::future<void> pending_;
+};
+
+}
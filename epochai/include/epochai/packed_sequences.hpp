@@ -0,0 +1,66 @@
+#pragma once
+
+#include "epochai/tokenizer.hpp"
+#include "epochai/vocabulary.hpp"
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace epochai {
+
+/// \file packed_sequences.hpp
+/// Ragged batch format for training and evaluation.
+///
+/// A batch stores every sequence back to back in one flat token-id buffer and
+/// records where each one starts in an offsets array, so memory is
+/// proportional to the real tokens and no padding is ever materialized.
+
+/// Flat buffer of token-id sequences. Sequence `i` spans
+/// `tokens[offsets[i], offsets[i + 1])`; `offsets` always starts with 0 and
+/// ends with `tokens.size()`.
+struct PackedSequences {
+    std::vector<TokenId> tokens;
+    std::vector<std::size_t> offsets{0};
+
+    std::size_t sequence_count() const noexcept { return offsets.size() - 1; }
+
+    std::span<const TokenId> sequence(std::size_t index) const noexcept {
+        return std::span<const TokenId>(tokens).subspan(offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    /// Append one complete sequence.
+    void append(std::span<const TokenId> sequence);
+
+    /// Remove all sequences, keeping capacity.
+    void clear() noexcept;
+};
+
+/// Token sink that interns streamed tokens and packs each line, terminated by
+/// `<eos>`, into a `PackedSequences` batch.
+///
+/// Only complete lines are added to `batch()`; tokens of a line that is still
+/// open are held back until its `on_line_end`, so the batch can be consumed and
+/// cleared after every chunk.
+class PackedSequenceBuilder final : public TokenSink {
+public:
+    explicit PackedSequenceBuilder(Vocabulary& vocab);
+
+    void on_token(std::string_view token) override;
+    void on_line_end() override;
+
+    /// Sequences completed since the last `clear_batch`.
+    const PackedSequences& batch() const noexcept { return batch_; }
+
+    /// Drop completed sequences; the open line, if any, is kept.
+    void clear_batch() noexcept { batch_.clear(); }
+
+private:
+    Vocabulary& vocab_;
+    TokenId eos_id_;
+    std::vector<TokenId> open_;
+    PackedSequences batch_;
+};
+
+}
@@ -1,13 +1,25 @@
 #pragma once
 
+#include "epochai/io_utils.hpp"
+#include "epochai/packed_sequences.hpp"
+#include "epochai/token_cache.hpp"
+#include "epochai/transition_table.hpp"
+#include "epochai/vocabulary.hpp"
+#include "epochai/worker_pool.hpp"
+
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <optional>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <string_view>
 #include <vector>
 
 namespace epochai {
 
+class MappedModel;
+struct ModelDelta;
+
 /// \file state.hpp
 /// Persistent training state management and high-level optimization helpers.
 ///
@@ -22,14 +34,43 @@ struct TrainingConfig {
     std::string lm_studio_url;
     int request_timeout_ms = 2000;
     int retries = 2;
+    /// Overall budget of one request across its retries and their backoff;
+    /// 0 bounds requests only per attempt.
+    int request_deadline_ms = 5000;
+    /// Threads used for training and evaluation; 0 selects the hardware
+    /// concurrency.
+    int worker_threads = 0;
+    /// Also write the human-readable `model_state.txt` after each save.
+    bool export_text_state = false;
+    /// Fold the checkpoint journal into a new snapshot once it reaches this
+    /// many bytes; 0 compacts after every step.
+    std::uint64_t journal_compact_bytes = std::uint64_t{64} << 20;
+    /// Steps between checkpoints in daemon mode; a final checkpoint is always
+    /// written on shutdown.
+    int checkpoint_interval_steps = 1;
+    /// Train only on dataset lines appended since the persisted watermark
+    /// instead of re-counting the whole corpus every step.
+    bool incremental_training = false;
+};
+
+/// How much of the dataset has already been trained on: the first `offset`
+/// bytes, which end on a line boundary and whose `ContentHasher` digest is
+/// `fingerprint`.
+struct DatasetWatermark {
+    std::uint64_t offset = 0;
+    std::uint64_t fingerprint = kEmptyContentHash;
 };
 
 /// Markov-style model state persisted between training runs.
+///
+/// Tokens are interned in `vocab`, whose token -> id index is maintained
+/// incrementally and rebuilt when the state is loaded. `transitions` holds the
+/// per-pair counts together with their row totals, keyed by id. The string
+/// form only appears at the `StateManager` load/save boundary.
 struct ModelState {
     int step = 0;
-    std::vector<std::string> vocab;
-    std::unordered_map<std::string, std::unordered_map<std::string, double>> transitions;
-    std::unordered_map<std::string, double> totals;
+    Vocabulary vocab;
+    TransitionTable transitions;
 };
 
 /// Summary of a single training iteration.
@@ -47,6 +88,48 @@ struct EvaluationStats {
     double perplexity = 0.0;
 };
 
+/// Transition occurrences aggregated from a corpus in a single pass.
+///
+/// Training and evaluation score the distinct pairs in `pairs`, weighted by
+/// their counts, instead of re-walking the token stream, so memory and work
+/// after collection scale with the number of distinct transitions.
+struct TransitionCounts {
+    TransitionTable pairs;
+    std::size_t transition_count = 0;
+    std::size_t sequence_count = 0;
+
+    /// Count every adjacent pair of every sequence in `batch`.
+    void add(const PackedSequences& batch);
+
+    /// Count the sequences `[first, last)` of `batch`.
+    void add(const PackedSequences& batch, std::size_t first, std::size_t last);
+
+    /// Fold `other` into this accumulator.
+    void merge(const TransitionCounts& other);
+};
+
+/// Collects `TransitionCounts` on a `WorkerPool`.
+///
+/// Each batch is split into contiguous sequence ranges of similar token
+/// count, one per worker, and every range is counted into that worker's own
+/// shard without synchronization. `take` merges the shards in shard order.
+/// Counts are integers, and training applies them in `(prev, next)` order, so
+/// the resulting `ModelState` is bit-identical to serial collection.
+class ShardedTransitionCounter {
+public:
+    explicit ShardedTransitionCounter(WorkerPool& pool);
+
+    /// Count `batch` across the pool. Blocks until every shard is updated.
+    void add(const PackedSequences& batch);
+
+    /// Merge and return everything counted so far, resetting the shards.
+    TransitionCounts take();
+
+private:
+    WorkerPool& pool_;
+    std::vector<TransitionCounts> shards_;
+};
+
 /// Filesystem-backed accessor for EpochAI state artifacts.
 class StateManager {
 public:
@@ -56,33 +139,116 @@ public:
     const std::filesystem::path& root() const noexcept { return root_; }
     std::filesystem::path config_path() const;
     std::filesystem::path dataset_path() const;
+    /// Binary model image (see `model_image.hpp`).
     std::filesystem::path model_state_path() const;
+    /// Legacy text model file, written only by `export_model_state_text`.
+    std::filesystem::path model_state_text_path() const;
+    std::filesystem::path dataset_watermark_path() const;
+    /// Tokenized dataset cache (see `token_cache.hpp`).
+    std::filesystem::path token_cache_path() const;
+    /// Directory holding the checkpoint journal segments.
+    std::filesystem::path journal_directory() const;
     std::filesystem::path log_path() const;
 
-    /// Load state from disk or create defaults when missing.
+    /// Load state from disk or create defaults when missing. The model is read
+    /// from the binary image, falling back to a legacy text file, and every
+    /// newer checkpoint journal record is replayed on top of it.
     TrainingConfig load_or_initialize_config();
-    std::vector<std::string> load_or_initialize_dataset();
     ModelState load_or_initialize_model_state();
 
-    /// Persist the supplied `state`, overwriting any previous version.
+    /// Snapshot with every journal record replayed in memory, or
+    /// `std::nullopt` when no snapshot exists. Never writes, so it is safe
+    /// next to a process that trains in the same directory.
+    std::optional<ModelState> read_model_state() const;
+
+    /// Stream the dataset in pieces of at most `chunk_size` bytes, creating the
+    /// default dataset when missing. Peak memory is bounded by `chunk_size`
+    /// regardless of the dataset size. An empty dataset is streamed as a fixed
+    /// fallback line.
+    void for_each_dataset_chunk(std::size_t chunk_size, const std::function<void(std::string_view)>& on_chunk);
+
+    /// Stream dataset bytes `[begin, end)`, with `end` clamped to the file
+    /// size. Unlike the whole-file overload an empty range yields no chunks.
+    void for_each_dataset_chunk(std::size_t chunk_size, std::uint64_t begin, std::uint64_t end,
+                                const std::function<void(std::string_view)>& on_chunk);
+
+    /// Offset just past the last newline of the dataset, or 0 when it has no
+    /// complete line, creating the default dataset when missing. Reads only
+    /// the end of the file.
+    std::uint64_t dataset_line_end();
+
+    /// Hash the first `watermark.offset` bytes of the dataset. When they still
+    /// match `watermark.fingerprint`, return the hasher positioned after them
+    /// so the digest can be continued over the rest of the file.
+    std::optional<ContentHasher> hash_dataset_prefix(const DatasetWatermark& watermark);
+
+    /// Persisted watermark, or `std::nullopt` when none was saved.
+    std::optional<DatasetWatermark> load_dataset_watermark() const;
+    void save_dataset_watermark(const DatasetWatermark& watermark);
+
+    /// Map the token cache when it was built from the current dataset
+    /// contents, or from the fallback line when the dataset is empty. Hashes
+    /// the dataset only when its size matches the cache; a missing, stale or
+    /// malformed cache yields `std::nullopt`.
+    std::optional<MappedTokenCache> open_token_cache();
+
+    /// Persist the supplied `state` as a full binary image, overwriting any
+    /// previous version and discarding the journal it supersedes. Must not
+    /// run concurrently with `compact_model_journal`.
     void save_model_state(const ModelState& state);
 
+    /// Checkpoint one training step by appending its changes to the journal.
+    void append_model_delta(const ModelDelta& delta);
+
+    /// Size of the checkpoint journal in bytes.
+    std::uintmax_t model_journal_bytes() const;
+
+    /// Seal the journal for compaction; later appends go to a new segment.
+    std::vector<std::filesystem::path> seal_model_journal();
+
+    /// Fold `sealed` journal segments into a new snapshot, then delete them.
+    /// Touches only the snapshot and `sealed`, so it may run on another
+    /// thread while `append_model_delta` continues.
+    void compact_model_journal(const std::vector<std::filesystem::path>& sealed);
+
+    /// Write `state` in the tab-separated text layout for inspection or for
+    /// tools that predate the binary format. Counts round-trip exactly.
+    void export_model_state_text(const ModelState& state);
+
 private:
+    /// Snapshot without journal replay, or `std::nullopt` when none exists.
+    std::optional<ModelState> load_model_snapshot() const;
+
     std::filesystem::path root_;
 };
 
-/// Perform one training iteration, mutating `state` in-place.
-TrainingStats train_one_step(ModelState& state, const std::vector<std::vector<std::string>>& sequences,
-                              std::size_t vocab_size);
+/// Perform one training iteration from pre-aggregated counts, mutating
+/// `state` in-place. `loss_before` and `loss_after` are computed from the same
+/// counts without revisiting the corpus. Counts are applied in `(prev, next)`
+/// order, so the result does not depend on how they were collected. When
+/// `pool` is given, both losses are scored on it; see `evaluate_model`.
+TrainingStats train_one_step(ModelState& state, const TransitionCounts& counts, std::size_t vocab_size,
+                             WorkerPool* pool = nullptr);
 
-/// Evaluate the model using the provided sequences without mutating state.
-EvaluationStats evaluate_model(const ModelState& state, const std::vector<std::vector<std::string>>& sequences,
-                               std::size_t vocab_size);
+/// Evaluate the model on pre-aggregated counts without mutating state.
+///
+/// The `(prev, next)`-ordered counts are scored in fixed-size blocks whose
+/// compensated sums are combined pairwise in block order. Block boundaries do
+/// not depend on `pool`, so the loss and perplexity are identical for any
+/// thread count, including the serial `pool == nullptr` path.
+EvaluationStats evaluate_model(const ModelState& state, const TransitionCounts& counts, std::size_t vocab_size,
+                               WorkerPool* pool = nullptr);
+
+/// Evaluate a memory-mapped model without materializing it.
+///
+/// `counts` refers to ids of `vocab`, which are translated to image ids by
+/// string once per token; tokens missing from the image score as unseen. The
+/// smoothing vocabulary is the union of image and `vocab` tokens, which is
+/// what a loaded `ModelState` holds after interning the same corpus.
+EvaluationStats evaluate_model(const MappedModel& model, const Vocabulary& vocab, const TransitionCounts& counts,
+                               WorkerPool* pool = nullptr);
 
 /// Ensure the state contains the required special tokens.
 void ensure_core_tokens(ModelState& state);
 
-/// Merge newly observed tokens into the vocabulary and update counters.
-void update_vocab(ModelState& state, const std::vector<std::string>& tokens);
-
 }
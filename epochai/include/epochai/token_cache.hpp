@@ -0,0 +1,132 @@
+#pragma once
+
+#include "epochai/count_metrics.hpp"
+#include "epochai/io_utils.hpp"
+#include "epochai/packed_sequences.hpp"
+#include "epochai/vocabulary.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace epochai {
+
+/// \file token_cache.hpp
+/// Binary cache of a tokenized dataset.
+///
+/// The cache stores what one ingest pass produced — token ids, sequence
+/// offsets and the tokens those ids name — keyed by the size and fingerprint
+/// of the dataset bytes it was built from. Ids are local to the cache: token
+/// `i` is the `i`-th distinct token of the dataset, with `<eos>` first, which
+/// is exactly the order in which tokenization would intern them. Replaying a
+/// cache into a `Vocabulary` therefore grows it identically to tokenizing the
+/// dataset, whatever the vocabulary already held.
+///
+/// A cache is a 96-byte `TokenCacheHeader` followed by these sections, each
+/// starting on an 8-byte boundary:
+///
+/// | Section         | Type       | Length               |
+/// |-----------------|------------|----------------------|
+/// | `tokens`        | `TokenId`  | `token_count`        |
+/// | `offsets`       | `uint64_t` | `sequence_count + 1` |
+/// | `vocab_offsets` | `uint64_t` | `vocab_size + 1`     |
+/// | `strings`       | bytes      | `string_bytes`       |
+
+/// Format revision written by `TokenCacheBuilder`. Bump it whenever the
+/// tokenizer output or the fingerprint function changes so stale caches are
+/// rebuilt.
+inline constexpr std::uint32_t kTokenCacheVersion = 2;
+
+/// Fixed-size leading block of a token cache.
+struct TokenCacheHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    /// Number of dataset bytes tokenized and their `ContentHasher` digest.
+    std::uint64_t dataset_bytes;
+    std::uint64_t fingerprint;
+    std::uint64_t token_count;
+    std::uint64_t sequence_count;
+    std::uint64_t vocab_size;
+    std::uint64_t string_bytes;
+    /// Aggregate `CountMetrics` of the pass.
+    std::uint64_t metric_tokens;
+    std::uint64_t metric_words;
+    std::uint64_t metric_letters;
+    std::uint64_t reserved;
+};
+static_assert(sizeof(TokenCacheHeader) == 96);
+
+/// Records the batches of an ingest pass into a cache file.
+///
+/// Token ids are streamed to a temporary file as batches arrive, so building
+/// a cache holds only the sequence offsets and the distinct tokens in memory,
+/// never the tokens themselves. The file replaces the cache on `finish`; a
+/// builder destroyed before then leaves the previous cache in place.
+class TokenCacheBuilder {
+public:
+    /// Record batches whose ids refer to `vocab` into a cache at `path`.
+    /// `vocab` must already hold `<eos>` and must outlive the builder.
+    TokenCacheBuilder(const Vocabulary& vocab, const std::filesystem::path& path);
+
+    /// Append the sequences of `batch`.
+    void add(const PackedSequences& batch);
+
+    /// Complete the cache for a pass over `dataset_bytes` bytes hashing to
+    /// `fingerprint` with the given aggregate metrics, fsync it and move it
+    /// into place.
+    void finish(std::uint64_t dataset_bytes, std::uint64_t fingerprint, const CountMetrics& metrics);
+
+private:
+    TokenId local_id(TokenId id);
+    void pad_to_alignment();
+
+    const Vocabulary& vocab_;
+    AtomicFileWriter file_;
+    /// `local_of_[id]` is one more than the local id of `id`, or 0 when unseen.
+    std::vector<TokenId> local_of_;
+    /// Vocabulary ids in local id order.
+    std::vector<TokenId> locals_;
+    std::vector<std::uint64_t> offsets_{0};
+    /// Encoding buffer for one batch, reused across `add` calls.
+    std::vector<TokenId> batch_locals_;
+};
+
+/// Read-only token cache served from a memory-mapped file.
+class MappedTokenCache {
+public:
+    /// Map and validate `path`: header, section sizes, offset monotonicity and
+    /// token id ranges. Throws `std::runtime_error` when the cache is malformed
+    /// and `std::system_error` when it cannot be opened.
+    explicit MappedTokenCache(const std::filesystem::path& path);
+
+    std::uint64_t dataset_bytes() const noexcept { return header_.dataset_bytes; }
+    std::uint64_t fingerprint() const noexcept { return header_.fingerprint; }
+    std::size_t token_count() const noexcept { return tokens_.size(); }
+    std::size_t sequence_count() const noexcept { return offsets_.size() - 1; }
+
+    /// Aggregate counters of the cached pass; `words` and `letters_per_word`
+    /// are left empty.
+    CountMetrics metrics() const;
+
+    /// Intern the cached tokens into `vocab`, then hand the sequences to
+    /// `on_batch` rewritten to `vocab` ids, in batches of whole sequences
+    /// holding roughly `batch_tokens` tokens each.
+    void replay(Vocabulary& vocab, std::size_t batch_tokens,
+                const std::function<void(const PackedSequences&)>& on_batch) const;
+
+private:
+    MappedFile file_;
+    TokenCacheHeader header_{};
+    std::span<const TokenId> tokens_;
+    std::span<const std::uint64_t> offsets_;
+    std::span<const std::uint64_t> vocab_offsets_;
+    std::string_view strings_;
+};
+
+}
@@ -12,8 +12,48 @@ namespace epochai {
 ///
 /// Tokenization is deterministic and whitespace-delimited; callers should
 /// normalize input prior to invoking `tokenize` to ensure consistent results.
+/// Character classes follow the "C" locale. Word boundaries are located with
+/// the widest SIMD kernel the host CPU supports (AVX2, SSE2, or a scalar
+/// table lookup); every kernel produces identical tokens.
 
 /// Split text into tokens compatible with `ModelState::vocab`.
 std::vector<std::string> tokenize(std::string_view text);
 
+/// Receives tokens and line boundaries from a `StreamingTokenizer`.
+class TokenSink {
+public:
+    virtual ~TokenSink() = default;
+
+    /// Called once per token, in input order.
+    virtual void on_token(std::string_view token) = 0;
+
+    /// Called after the last token of every input line, including empty lines.
+    virtual void on_line_end() = 0;
+};
+
+/// Incremental tokenizer for inputs that arrive in arbitrary chunks.
+///
+/// Words split across chunk boundaries are carried over and emitted once they
+/// are complete, so feeding a buffer piecewise yields the same tokens as
+/// tokenizing each of its `\n`-separated lines with `tokenize`. Memory use is
+/// bounded by the chunk size plus the longest word. Token views passed to the
+/// sink stay valid until the next call to `feed` or `finish`.
+class StreamingTokenizer {
+public:
+    /// Tokenize `chunk`, continuing any word left open by the previous chunk.
+    void feed(std::string_view chunk, TokenSink& sink);
+
+    /// Flush the trailing word and close the final line if it lacks a newline.
+    void finish(TokenSink& sink);
+
+private:
+    std::string partial_;
+    std::string joined_;
+    bool line_open_ = false;
+};
+
+/// Name of the boundary-search kernel selected for this process
+/// (`"avx2"`, `"sse2"` or `"scalar"`).
+std::string_view tokenizer_kernel_name();
+
 }
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace epochai {
+
+/// \file vocabulary.hpp
+/// Token interning for the Markov model.
+///
+/// A `Vocabulary` assigns each distinct token string a dense `TokenId` in
+/// insertion order and keeps a persistent reverse index, so merging new
+/// tokens is an amortized O(1) hash lookup per token. The index supports
+/// heterogeneous lookup, so probing with a `std::string_view` never allocates.
+
+/// Dense identifier of a vocabulary entry.
+using TokenId = std::uint32_t;
+
+/// Reserved padding token, kept in every vocabulary for compatibility.
+inline constexpr std::string_view kPadToken = "<pad>";
+
+/// End-of-sequence token appended to every training line.
+inline constexpr std::string_view kEosToken = "<eos>";
+
+/// Bidirectional token <-> id mapping with stable, dense ids.
+class Vocabulary {
+public:
+    /// Return the id of `token`, appending it when unseen.
+    TokenId intern(std::string_view token);
+
+    /// Look up the id of `token` without modifying the vocabulary.
+    std::optional<TokenId> find(std::string_view token) const;
+
+    /// Whether `token` is present.
+    bool contains(std::string_view token) const { return find(token).has_value(); }
+
+    /// Token string for `id`. `id` must be less than `size()`.
+    const std::string& operator[](TokenId id) const { return tokens_[id]; }
+
+    std::size_t size() const noexcept { return tokens_.size(); }
+    bool empty() const noexcept { return tokens_.empty(); }
+
+    /// Tokens in id order.
+    const std::vector<std::string>& tokens() const noexcept { return tokens_; }
+    auto begin() const noexcept { return tokens_.begin(); }
+    auto end() const noexcept { return tokens_.end(); }
+
+    /// Pre-size storage and index for `count` tokens, e.g. before loading.
+    void reserve(std::size_t count);
+
+private:
+    struct TokenHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view token) const noexcept {
+            return std::hash<std::string_view>{}(token);
+        }
+    };
+
+    std::vector<std::string> tokens_;
+    std::unordered_map<std::string, TokenId, TokenHash, std::equal_to<>> index_;
+};
+
+}
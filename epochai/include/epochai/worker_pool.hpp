@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace epochai {
+
+/// \file worker_pool.hpp
+/// Fixed-size thread pool for data-parallel loops.
+///
+/// Work is expressed as an index range; which thread runs which index is
+/// unspecified, so callers that need reproducible results must make every
+/// index write to its own output slot and combine the slots in index order.
+
+/// Persistent worker threads executing `parallel_for` jobs.
+class WorkerPool {
+public:
+    /// Create a pool with `threads` participants including the calling thread.
+    /// Zero selects `std::thread::hardware_concurrency()`.
+    explicit WorkerPool(std::size_t threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// Number of threads that execute jobs, including the caller.
+    std::size_t size() const noexcept { return workers_.size() + 1; }
+
+    /// Invoke `fn(i)` for every `i` in `[0, count)` and block until all calls
+    /// return. The calling thread participates. The first exception thrown by
+    /// `fn` is rethrown after the remaining indices finish. Not reentrant.
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& fn);
+
+private:
+    void worker_loop();
+    void run_indices();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(std::size_t)>* job_ = nullptr;
+    std::size_t job_count_ = 0;
+    std::atomic<std::size_t> next_index_{0};
+    std::size_t busy_workers_ = 0;
+    std::uint64_t generation_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
+
+}
@@ -1,39 +1,36 @@
 #include "epochai/app.hpp"
 
+#include "epochai/checkpoint_writer.hpp"
 #include "epochai/count_metrics.hpp"
 #include "epochai/http_client.hpp"
 #include "epochai/io_utils.hpp"
 #include "epochai/logger.hpp"
+#include "epochai/model_image.hpp"
+#include "epochai/model_journal.hpp"
 #include "epochai/state.hpp"
+#include "epochai/token_cache.hpp"
 #include "epochai/tokenizer.hpp"
 
 #include <algorithm>
 #include <chrono>
+#include <csignal>
 #include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <future>
 #include <iostream>
-#include <numeric>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace epochai {
 namespace {
 
-constexpr std::string_view kPadToken = "<pad>";
-constexpr std::string_view kEosToken = "<eos>";
-
-std::string join_lines(const std::vector<std::string>& lines) {
-    std::ostringstream oss;
-    for (std::size_t i = 0; i < lines.size(); ++i) {
-        if (i != 0) {
-            oss << '\n';
-        }
-        oss << lines[i];
-    }
-    return oss.str();
-}
+constexpr std::size_t kDatasetChunkSize = std::size_t{1} << 20;
+constexpr std::chrono::milliseconds kDatasetPollInterval{250};
 
 std::string escape_json(std::string_view text) {
     std::ostringstream oss;
@@ -62,14 +59,252 @@ std::string escape_json(std::string_view text) {
     return oss.str();
 }
 
-std::string hash_string(const std::string& value) {
-    return to_hex(static_cast<std::uint64_t>(std::hash<std::string>{}(value)));
+std::string hash_string(std::string_view value) {
+    return to_hex(content_hash(value));
+}
+
+/// Everything the single streamed pass over the dataset produces.
+struct DatasetPass {
+    CountMetrics metrics;
+    TransitionCounts counts;
+    std::string hash;
+    /// Digest of every byte hashed, including a prefix the pass resumed after.
+    std::uint64_t fingerprint = kEmptyContentHash;
+    /// Whether the pass was replayed from the token cache.
+    bool cached = false;
+};
+
+using ChunkReader = std::function<void(const std::function<void(std::string_view)>&)>;
+
+/// Tokenize the chunks produced by `read` in a single pass. That pass grows
+/// `vocab`, gathers metrics, continues the fingerprint in `hasher` and
+/// aggregates the transition counts that training and evaluation score, so
+/// the corpus is never held in memory or re-read. Counting each batch and
+/// the metrics of each chunk is sharded across `pool`. When `token_cache` is
+/// set the pass is recorded to a token cache at that path as it streams.
+DatasetPass ingest_chunks(const ChunkReader& read, ContentHasher hasher, Vocabulary& vocab, WorkerPool& pool,
+                          const std::filesystem::path* token_cache = nullptr) {
+    DatasetPass pass;
+    StreamingTokenizer ingest_tokenizer;
+    PackedSequenceBuilder builder(vocab);
+    MetricsCounter metrics;
+    ShardedTransitionCounter counter(pool);
+    std::optional<TokenCacheBuilder> recorder;
+    if (token_cache) {
+        recorder.emplace(vocab, *token_cache);
+    }
+    std::uint64_t dataset_bytes = 0;
+    auto absorb_batch = [&]() {
+        counter.add(builder.batch());
+        if (recorder) {
+            recorder->add(builder.batch());
+        }
+        builder.clear_batch();
+    };
+    read([&](std::string_view chunk) {
+        hasher.update(chunk);
+        dataset_bytes += chunk.size();
+        metrics.feed(chunk, pool);
+        ingest_tokenizer.feed(chunk, builder);
+        absorb_batch();
+    });
+    ingest_tokenizer.finish(builder);
+    absorb_batch();
+    pass.metrics = metrics.finish();
+    pass.counts = counter.take();
+    pass.fingerprint = hasher.digest();
+    pass.hash = to_hex(pass.fingerprint);
+    if (recorder) {
+        recorder->finish(dataset_bytes, pass.fingerprint, pass.metrics);
+    }
+    return pass;
+}
+
+/// Rebuild a pass from a token cache without tokenizing anything.
+DatasetPass replay_token_cache(const MappedTokenCache& cache, Vocabulary& vocab, WorkerPool& pool) {
+    DatasetPass pass;
+    ShardedTransitionCounter counter(pool);
+    cache.replay(vocab, kDatasetChunkSize, [&](const PackedSequences& batch) { counter.add(batch); });
+    pass.metrics = cache.metrics();
+    pass.counts = counter.take();
+    pass.fingerprint = cache.fingerprint();
+    pass.hash = to_hex(cache.fingerprint());
+    pass.cached = true;
+    return pass;
+}
+
+/// Stream the whole dataset once. A token cache built from the same contents
+/// is replayed instead; otherwise the pass refreshes the cache when
+/// `refresh_cache` is set.
+DatasetPass ingest_dataset(StateManager& manager, Vocabulary& vocab, WorkerPool& pool, bool refresh_cache = true) {
+    if (const auto cache = manager.open_token_cache()) {
+        return replay_token_cache(*cache, vocab, pool);
+    }
+    const auto token_cache = manager.token_cache_path();
+    return ingest_chunks(
+        [&](const auto& on_chunk) { manager.for_each_dataset_chunk(kDatasetChunkSize, on_chunk); },
+        ContentHasher{}, vocab, pool, refresh_cache ? &token_cache : nullptr);
+}
+
+/// Stream only the complete lines appended after `watermark`, or every
+/// complete line when the dataset no longer starts with the watermarked
+/// prefix. An unterminated last line waits until its newline arrives.
+/// Returns `std::nullopt` when there is nothing new; otherwise advances
+/// `watermark` and sets `full_pass` when the prefix had changed.
+std::optional<DatasetPass> ingest_dataset_tail(StateManager& manager, Vocabulary& vocab, WorkerPool& pool,
+                                               DatasetWatermark& watermark, bool& full_pass) {
+    const auto end = manager.dataset_line_end();
+    std::uint64_t begin = watermark.offset;
+    auto prefix = begin <= end ? manager.hash_dataset_prefix(watermark) : std::nullopt;
+    full_pass = !prefix;
+    if (full_pass) {
+        begin = 0;
+        prefix.emplace();
+    }
+    if (begin == end) {
+        return std::nullopt;
+    }
+    auto pass = ingest_chunks(
+        [&](const auto& on_chunk) { manager.for_each_dataset_chunk(kDatasetChunkSize, begin, end, on_chunk); },
+        *prefix, vocab, pool);
+    watermark = DatasetWatermark{end, pass.fingerprint};
+    return pass;
+}
+
+void log_dataset_metrics(EventLogger& logger, const DatasetPass& dataset) {
+    std::ostringstream metrics_log;
+    metrics_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+    metrics_log << "\"action\":\"dataset_metrics\",";
+    metrics_log << "\"tokens\":" << dataset.metrics.tokens << ",";
+    metrics_log << "\"words\":" << dataset.metrics.word_count << ",";
+    metrics_log << "\"total_letters\":" << dataset.metrics.total_letters << ",";
+    metrics_log << "\"hash\":\"" << dataset.hash << "\"}";
+    logger.log_line(metrics_log.str());
+
+    std::ostringstream cache_log;
+    cache_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+    cache_log << "\"action\":\"token_cache\",";
+    cache_log << "\"hit\":" << (dataset.cached ? "true" : "false") << "}";
+    logger.log_line(cache_log.str());
+}
+
+void log_evaluation(EventLogger& logger, const EvaluationStats& stats, std::int64_t step) {
+    std::ostringstream eval_log;
+    eval_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+    eval_log << "\"action\":\"evaluation\",";
+    eval_log << "\"loss\":" << stats.loss << ",";
+    eval_log << "\"perplexity\":" << stats.perplexity << ",";
+    eval_log << "\"step\":" << step << "}";
+    logger.log_line(eval_log.str());
+}
+
+void log_checkpoint(EventLogger& logger, const CheckpointReport& report) {
+    std::ostringstream checkpoint_log;
+    checkpoint_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+    checkpoint_log << "\"action\":\"checkpoint\",";
+    checkpoint_log << "\"step\":" << report.step << ",";
+    checkpoint_log << "\"journal_bytes\":" << report.journal_bytes << ",";
+    checkpoint_log << "\"compaction\":" << (report.compaction_started ? "true" : "false") << ",";
+    checkpoint_log << "\"latency_ms\":" << report.latency.count() << "}";
+    logger.log_line(checkpoint_log.str());
+}
+
+/// Evaluate the model as it would be loaded for training, replaying the
+/// journal in memory. Used when the image alone is not current.
+int run_replayed_evaluation(StateManager& manager, EventLogger& logger, WorkerPool& pool) {
+    auto state = manager.read_model_state().value_or(ModelState{});
+    ensure_core_tokens(state);
+    const auto dataset = ingest_dataset(manager, state.vocab, pool, false);
+    log_dataset_metrics(logger, dataset);
+    const auto stats = evaluate_model(state, dataset.counts, state.vocab.size(), &pool);
+    log_evaluation(logger, stats, state.step);
+
+    std::cout << "EpochAI evaluation of step " << state.step << " completed." << std::endl;
+    std::cout << "Evaluation loss: " << stats.loss << ", perplexity: " << stats.perplexity << std::endl;
+    return 0;
+}
+
+/// Evaluate the persisted model on the dataset straight from its mapped image.
+/// Nothing is trained and no model, journal or cache file is written, so
+/// evaluation may run next to a training process on the same directory. The
+/// model is never materialized unless journal records are pending, so startup
+/// does not scale with model size.
+int run_mapped_evaluation(StateManager& manager, EventLogger& logger, WorkerPool& pool) {
+    if (!std::filesystem::exists(manager.model_state_path()) || manager.model_journal_bytes() > 0) {
+        return run_replayed_evaluation(manager, logger, pool);
+    }
+    const auto load_start = std::chrono::steady_clock::now();
+    const MappedModel model(manager.model_state_path());
+    const auto load_latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - load_start);
+
+    Vocabulary dataset_vocab;
+    const auto dataset = ingest_dataset(manager, dataset_vocab, pool, false);
+    log_dataset_metrics(logger, dataset);
+
+    const auto eval_start = std::chrono::steady_clock::now();
+    const auto stats = evaluate_model(model, dataset_vocab, dataset.counts, &pool);
+    const auto eval_latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - eval_start);
+    log_evaluation(logger, stats, model.step());
+
+    std::ostringstream mapped_log;
+    mapped_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+    mapped_log << "\"action\":\"mapped_evaluation\",";
+    mapped_log << "\"vocab\":" << model.vocab_size() << ",";
+    mapped_log << "\"transitions\":" << model.view().next_ids.size() << ",";
+    mapped_log << "\"load_ms\":" << load_latency.count() << ",";
+    mapped_log << "\"latency_ms\":" << eval_latency.count() << "}";
+    logger.log_line(mapped_log.str());
+
+    std::cout << "EpochAI evaluation of step " << model.step() << " completed." << std::endl;
+    std::cout << "Evaluation loss: " << stats.loss << ", perplexity: " << stats.perplexity << std::endl;
+    return 0;
+}
+
+/// Set from SIGINT/SIGTERM to end a resident training session.
+volatile std::sig_atomic_t g_stop_requested = 0;
+
+extern "C" void handle_stop_signal(int) {
+    g_stop_requested = 1;
+}
+
+void install_stop_handlers() {
+    std::signal(SIGINT, handle_stop_signal);
+    std::signal(SIGTERM, handle_stop_signal);
+}
+
+bool stop_requested() {
+    return g_stop_requested != 0;
+}
+
+/// Cheap change detector for the dataset file, so a resident session only
+/// re-reads it after it was modified.
+struct DatasetStamp {
+    std::uintmax_t size = 0;
+    std::filesystem::file_time_type modified;
+
+    bool operator==(const DatasetStamp&) const = default;
+};
+
+std::optional<DatasetStamp> dataset_stamp_of(const std::filesystem::path& path) {
+    std::error_code ec;
+    DatasetStamp stamp;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    stamp.modified = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return stamp;
 }
 
 } // namespace
 
-Application::Application(std::string state_directory)
-    : state_directory_(std::move(state_directory)) {}
+Application::Application(std::string state_directory, ApplicationOptions options)
+    : state_directory_(std::move(state_directory)), options_(options) {}
 
 int Application::run() {
     StateManager manager(state_directory_);
@@ -77,80 +312,170 @@ int Application::run() {
     EventLogger logger(manager.log_path());
 
     const auto start_timestamp = format_utc_timestamp();
-    logger.log_line(std::string("{\"timestamp\":\"") + start_timestamp + "\",\"action\":\"startup\",\"version\":\"" + EPOCHAI_VERSION + "\"}");
+    logger.log_line(std::string("{\"timestamp\":\"") + start_timestamp + "\",\"action\":\"startup\",\"version\":\"" + EPOCHAI_VERSION +
+                    "\",\"tokenizer\":\"" + std::string(tokenizer_kernel_name()) + "\"}");
 
     const auto config = manager.load_or_initialize_config();
-    auto dataset_lines = manager.load_or_initialize_dataset();
+    WorkerPool pool(static_cast<std::size_t>(config.worker_threads));
+    if (options_.evaluate_only) {
+        return run_mapped_evaluation(manager, logger, pool);
+    }
     auto state = manager.load_or_initialize_model_state();
     ensure_core_tokens(state);
+    CheckpointWriter checkpoints(manager, config.journal_compact_bytes);
 
-    std::vector<std::vector<std::string>> raw_sequences;
-    raw_sequences.reserve(dataset_lines.size());
-    for (const auto& line : dataset_lines) {
-        auto tokens = tokenize(line);
-        update_vocab(state, tokens);
-        tokens.push_back(std::string(kEosToken));
-        raw_sequences.push_back(tokens);
-    }
-    const std::size_t max_length = std::accumulate(raw_sequences.begin(), raw_sequences.end(), std::size_t{0},
-                                                   [](std::size_t acc, const auto& seq) { return std::max(acc, seq.size()); });
-    std::vector<std::vector<std::string>> sequences;
-    sequences.reserve(raw_sequences.size());
-    for (auto& seq : raw_sequences) {
-        std::vector<std::string> padded(std::max<std::size_t>(1, max_length), std::string(kPadToken));
-        for (std::size_t i = 0; i < seq.size(); ++i) {
-            padded[i] = std::move(seq[i]);
-        }
-        sequences.push_back(std::move(padded));
+    // In daemon mode the model stays in memory across steps. The dataset is
+    // re-ingested only when the file changes, and checkpoints cover every
+    // `checkpoint_interval_steps` steps plus whatever remains at shutdown.
+    const bool resident = options_.steps != 1;
+    if (resident) {
+        install_stop_handlers();
     }
+    const int checkpoint_interval = std::max(config.checkpoint_interval_steps, 1);
+    std::size_t persisted_vocab = state.vocab.size();
+    TransitionCounts unsaved;
+    int unsaved_steps = 0;
+    std::optional<std::future<CheckpointReport>> checkpoint;
 
-    const auto dataset_blob = join_lines(dataset_lines);
-    const auto metrics = count_metrics(dataset_blob);
-    std::ostringstream metrics_log;
-    metrics_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
-    metrics_log << "\"action\":\"dataset_metrics\",";
-    metrics_log << "\"tokens\":" << metrics.tokens << ",";
-    metrics_log << "\"words\":" << metrics.word_count << ",";
-    metrics_log << "\"total_letters\":" << metrics.total_letters << ",";
-    metrics_log << "\"hash\":\"" << hash_string(dataset_blob) << "\"}";
-    logger.log_line(metrics_log.str());
+    // Incremental training consumes each complete dataset line once. The
+    // watermark is persisted only after the checkpoint covering it is
+    // durable, so a crash can at worst retrain the latest tail.
+    DatasetWatermark watermark = manager.load_dataset_watermark().value_or(DatasetWatermark{});
+    std::optional<DatasetWatermark> unsaved_watermark;
+    std::optional<DatasetWatermark> checkpoint_watermark;
 
-    const std::size_t vocab_size = state.vocab.size();
-    const auto train_start = std::chrono::steady_clock::now();
-    auto stats = train_one_step(state, sequences, vocab_size);
-    const auto train_latency = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - train_start);
-
-    manager.save_model_state(state);
-
-    std::ostringstream train_log;
-    train_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
-    train_log << "\"action\":\"train\",";
-    train_log << "\"step\":" << state.step << ",";
-    train_log << "\"loss_before\":" << stats.loss_before << ",";
-    train_log << "\"loss_after\":" << stats.loss_after << ",";
-    train_log << "\"perplexity\":" << stats.perplexity << ",";
-    train_log << "\"tokens\":" << stats.token_count << ",";
-    train_log << "\"sequences\":" << stats.sequence_count << ",";
-    train_log << "\"latency_ms\":" << train_latency.count() << ",";
-    train_log << "\"dataset_hash\":\"" << hash_string(dataset_blob) << "\"}";
-    logger.log_line(train_log.str());
-
-    const auto eval_stats = evaluate_model(state, sequences, state.vocab.size());
-    std::ostringstream eval_log;
-    eval_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
-    eval_log << "\"action\":\"evaluation\",";
-    eval_log << "\"loss\":" << eval_stats.loss << ",";
-    eval_log << "\"perplexity\":" << eval_stats.perplexity << ",";
-    eval_log << "\"step\":" << state.step << "}";
-    logger.log_line(eval_log.str());
+    auto finish_checkpoint = [&]() {
+        if (!checkpoint) {
+            return;
+        }
+        log_checkpoint(logger, checkpoint->get());
+        checkpoint.reset();
+        if (checkpoint_watermark) {
+            manager.save_dataset_watermark(*checkpoint_watermark);
+            checkpoint_watermark.reset();
+        }
+    };
+    auto submit_checkpoint = [&]() {
+        finish_checkpoint();
+        // The step's changes are frozen into a delta and written, fsynced and
+        // compacted on the checkpoint thread while training proceeds.
+        checkpoint = checkpoints.submit(make_model_delta(state, persisted_vocab, unsaved));
+        checkpoint_watermark = std::exchange(unsaved_watermark, std::nullopt);
+        persisted_vocab = state.vocab.size();
+        unsaved = TransitionCounts{};
+        unsaved_steps = 0;
+        if (config.export_text_state) {
+            manager.export_model_state_text(state);
+        }
+    };
+
+    std::optional<DatasetPass> dataset;
+    std::optional<DatasetStamp> dataset_stamp;
+    TrainingStats stats;
+    std::size_t steps_run = 0;
+    const auto session_start = std::chrono::steady_clock::now();
+    while ((options_.steps == 0 || steps_run < options_.steps) && !stop_requested()) {
+        const auto stamp = dataset_stamp_of(manager.dataset_path());
+        const bool changed = !stamp || stamp != dataset_stamp;
+        if (config.incremental_training) {
+            const auto from = watermark.offset;
+            bool full_pass = false;
+            dataset.reset();
+            if (changed) {
+                dataset = ingest_dataset_tail(manager, state.vocab, pool, watermark, full_pass);
+            }
+            dataset_stamp = stamp;
+            if (!dataset) {
+                // Nothing new to learn from; a resident session polls for
+                // appended lines instead of retraining on consumed ones.
+                if (!resident) {
+                    break;
+                }
+                std::this_thread::sleep_for(kDatasetPollInterval);
+                continue;
+            }
+            unsaved_watermark = watermark;
+            log_dataset_metrics(logger, *dataset);
+            std::ostringstream watermark_log;
+            watermark_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+            watermark_log << "\"action\":\"dataset_watermark\",";
+            watermark_log << "\"from\":" << (full_pass ? 0 : from) << ",";
+            watermark_log << "\"to\":" << watermark.offset << ",";
+            watermark_log << "\"full_pass\":" << (full_pass ? "true" : "false") << "}";
+            logger.log_line(watermark_log.str());
+        } else if (changed || !dataset) {
+            dataset = ingest_dataset(manager, state.vocab, pool);
+            dataset_stamp = stamp;
+            log_dataset_metrics(logger, *dataset);
+        }
+        const auto& counts = dataset->counts;
+
+        const std::size_t vocab_size = state.vocab.size();
+        const auto train_start = std::chrono::steady_clock::now();
+        stats = train_one_step(state, counts, vocab_size, &pool);
+        const auto train_latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - train_start);
+        unsaved.merge(counts);
+        if (++unsaved_steps >= checkpoint_interval) {
+            submit_checkpoint();
+        }
+
+        std::ostringstream train_log;
+        train_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+        train_log << "\"action\":\"train\",";
+        train_log << "\"step\":" << state.step << ",";
+        train_log << "\"loss_before\":" << stats.loss_before << ",";
+        train_log << "\"loss_after\":" << stats.loss_after << ",";
+        train_log << "\"perplexity\":" << stats.perplexity << ",";
+        train_log << "\"tokens\":" << stats.token_count << ",";
+        train_log << "\"sequences\":" << stats.sequence_count << ",";
+        train_log << "\"latency_ms\":" << train_latency.count() << ",";
+        train_log << "\"dataset_hash\":\"" << dataset->hash << "\"}";
+        logger.log_line(train_log.str());
+
+        const auto eval_stats = evaluate_model(state, counts, state.vocab.size(), &pool);
+        log_evaluation(logger, eval_stats, state.step);
+        ++steps_run;
+    }
+    if (unsaved_steps > 0) {
+        submit_checkpoint();
+    }
+    finish_checkpoint();
+    if (resident) {
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - session_start);
+        std::ostringstream daemon_log;
+        daemon_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
+        daemon_log << "\"action\":\"daemon_stop\",";
+        daemon_log << "\"steps\":" << steps_run << ",";
+        daemon_log << "\"step\":" << state.step << ",";
+        daemon_log << "\"stop_signal\":" << (stop_requested() ? "true" : "false") << ",";
+        daemon_log << "\"steps_per_second\":" << (elapsed.count() > 0 ? steps_run / elapsed.count() : 0.0) << "}";
+        logger.log_line(daemon_log.str());
+    }
 
     HttpClient client;
 
     const std::string health_request =
         "{\"jsonrpc\":\"2.0\",\"id\":\"health\",\"method\":\"health\",\"params\":{}}";
-    HttpRequest mcp_health{.method = "POST", .url = config.mcp_url, .body = health_request};
-    const auto mcp_health_result = client.perform(mcp_health, config.request_timeout_ms, config.retries);
+    const std::string call_request =
+        "{\"jsonrpc\":\"2.0\",\"id\":\"call\",\"method\":\"call\",\"params\":{\"message\":\"ping\"}}";
+    const std::string lm_request_body =
+        "{\"model\":\"default\",\"messages\":[{\"role\":\"user\",\"content\":\"Hello from EpochAI.\"}]}";
+
+    // The probes are independent, so they run concurrently on the client's
+    // event loop and together take as long as the slowest one.
+    auto mcp_health_pending =
+        client.perform_async({.method = "POST", .url = config.mcp_url, .body = health_request},
+                             config.request_timeout_ms, config.retries, config.request_deadline_ms);
+    auto mcp_call_pending =
+        client.perform_async({.method = "POST", .url = config.mcp_url, .body = call_request},
+                             config.request_timeout_ms, config.retries, config.request_deadline_ms);
+    auto lm_pending =
+        client.perform_async({.method = "POST", .url = config.lm_studio_url, .body = lm_request_body},
+                             config.request_timeout_ms, config.retries, config.request_deadline_ms);
+    const auto mcp_health_result = mcp_health_pending.get();
+    const auto mcp_call_result = mcp_call_pending.get();
+    const auto lm_result = lm_pending.get();
 
     std::ostringstream mcp_health_log;
     mcp_health_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
@@ -159,19 +484,16 @@ int Application::run() {
     if (mcp_health_result.success) {
         mcp_health_log << "\"status\":" << mcp_health_result.response.status << ",";
         mcp_health_log << "\"latency_ms\":" << mcp_health_result.latency.count() << ",";
-        mcp_health_log << "\"response_hash\":\"" << hash_string(mcp_health_result.response.body) << "\"";
+        mcp_health_log << "\"response_hash\":\"" << hash_string(mcp_health_result.response.body) << "\",";
     } else {
         mcp_health_log << "\"error\":\"" << escape_json(mcp_health_result.error_message) << "\",";
-        mcp_health_log << "\"latency_ms\":" << mcp_health_result.latency.count() << "";
+        mcp_health_log << "\"latency_ms\":" << mcp_health_result.latency.count() << ",";
     }
+    mcp_health_log << "\"attempts\":" << mcp_health_result.attempts << ",";
+    mcp_health_log << "\"circuit\":\"" << circuit_state_name(mcp_health_result.circuit) << "\"";
     mcp_health_log << "}";
     logger.log_line(mcp_health_log.str());
 
-    const std::string call_request =
-        "{\"jsonrpc\":\"2.0\",\"id\":\"call\",\"method\":\"call\",\"params\":{\"message\":\"ping\"}}";
-    HttpRequest mcp_call{.method = "POST", .url = config.mcp_url, .body = call_request};
-    const auto mcp_call_result = client.perform(mcp_call, config.request_timeout_ms, config.retries);
-
     std::ostringstream mcp_call_log;
     mcp_call_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
     mcp_call_log << "\"action\":\"mcp_call\",";
@@ -179,19 +501,16 @@ int Application::run() {
     if (mcp_call_result.success) {
         mcp_call_log << "\"status\":" << mcp_call_result.response.status << ",";
         mcp_call_log << "\"latency_ms\":" << mcp_call_result.latency.count() << ",";
-        mcp_call_log << "\"response_hash\":\"" << hash_string(mcp_call_result.response.body) << "\"";
+        mcp_call_log << "\"response_hash\":\"" << hash_string(mcp_call_result.response.body) << "\",";
     } else {
         mcp_call_log << "\"error\":\"" << escape_json(mcp_call_result.error_message) << "\",";
-        mcp_call_log << "\"latency_ms\":" << mcp_call_result.latency.count() << "";
+        mcp_call_log << "\"latency_ms\":" << mcp_call_result.latency.count() << ",";
     }
+    mcp_call_log << "\"attempts\":" << mcp_call_result.attempts << ",";
+    mcp_call_log << "\"circuit\":\"" << circuit_state_name(mcp_call_result.circuit) << "\"";
     mcp_call_log << "}";
     logger.log_line(mcp_call_log.str());
 
-    const std::string lm_request_body =
-        "{\"model\":\"default\",\"messages\":[{\"role\":\"user\",\"content\":\"Hello from EpochAI.\"}]}";
-    HttpRequest lm_request{.method = "POST", .url = config.lm_studio_url, .body = lm_request_body};
-    const auto lm_result = client.perform(lm_request, config.request_timeout_ms, config.retries);
-
     std::ostringstream lm_log;
     lm_log << "{\"timestamp\":\"" << format_utc_timestamp() << "\",";
     lm_log << "\"action\":\"lm_studio_chat\",";
@@ -199,16 +518,27 @@ int Application::run() {
     if (lm_result.success) {
         lm_log << "\"status\":" << lm_result.response.status << ",";
         lm_log << "\"latency_ms\":" << lm_result.latency.count() << ",";
-        lm_log << "\"response_hash\":\"" << hash_string(lm_result.response.body) << "\"";
+        lm_log << "\"response_hash\":\"" << hash_string(lm_result.response.body) << "\",";
     } else {
         lm_log << "\"error\":\"" << escape_json(lm_result.error_message) << "\",";
-        lm_log << "\"latency_ms\":" << lm_result.latency.count() << "";
+        lm_log << "\"latency_ms\":" << lm_result.latency.count() << ",";
     }
+    lm_log << "\"attempts\":" << lm_result.attempts << ",";
+    lm_log << "\"circuit\":\"" << circuit_state_name(lm_result.circuit) << "\"";
     lm_log << "}";
     logger.log_line(lm_log.str());
 
-    std::cout << "EpochAI autodidact step " << state.step << " completed." << std::endl;
-    std::cout << "Training loss: " << stats.loss_after << ", perplexity: " << stats.perplexity << std::endl;
+    checkpoints.drain();
+
+    if (resident) {
+        std::cout << "EpochAI daemon ran " << steps_run << " steps." << std::endl;
+    }
+    if (steps_run == 0) {
+        std::cout << "EpochAI found no new dataset lines; model remains at step " << state.step << "." << std::endl;
+    } else {
+        std::cout << "EpochAI autodidact step " << state.step << " completed." << std::endl;
+        std::cout << "Training loss: " << stats.loss_after << ", perplexity: " << stats.perplexity << std::endl;
+    }
     if (!mcp_health_result.success) {
         std::cout << "MCP health check failed: " << mcp_health_result.error_message << std::endl;
     }
@@ -0,0 +1,76 @@
+#include "epochai/checkpoint_writer.hpp"
+
+#include <utility>
+
+namespace epochai {
+
+CheckpointWriter::CheckpointWriter(StateManager& manager, std::uintmax_t compact_threshold_bytes)
+    : manager_(manager),
+      compact_threshold_bytes_(compact_threshold_bytes),
+      compactor_(manager),
+      thread_([this]() { run(); }) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+}
+
+std::future<CheckpointReport> CheckpointWriter::submit(ModelDelta delta) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&]() { return !pending_ && !busy_; });
+    pending_.emplace(Job{std::move(delta), {}});
+    auto future = pending_->promise.get_future();
+    lock.unlock();
+    changed_.notify_all();
+    return future;
+}
+
+void CheckpointWriter::drain() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&]() { return !pending_ && !busy_; });
+    }
+    // The writer thread is idle, so it is not touching the compactor.
+    compactor_.wait();
+}
+
+void CheckpointWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [&]() { return pending_.has_value() || stopping_; });
+        if (!pending_) {
+            return;
+        }
+        Job job = std::move(*pending_);
+        pending_.reset();
+        busy_ = true;
+        lock.unlock();
+        try {
+            job.promise.set_value(write(job.delta));
+        } catch (...) {
+            job.promise.set_exception(std::current_exception());
+        }
+        lock.lock();
+        busy_ = false;
+        changed_.notify_all();
+    }
+}
+
+CheckpointReport CheckpointWriter::write(const ModelDelta& delta) {
+    const auto start = std::chrono::steady_clock::now();
+    CheckpointReport report;
+    report.step = delta.step;
+    manager_.append_model_delta(delta);
+    report.journal_bytes = manager_.model_journal_bytes();
+    // Sealing happens on this thread, after the append, so the journal order
+    // seen by compaction matches the submission order.
+    report.compaction_started = compactor_.start_if_due(compact_threshold_bytes_);
+    report.latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    return report;
+}
+
+}
@@ -1,35 +1,191 @@
 #include "epochai/count_metrics.hpp"
 
-#include "epochai/tokenizer.hpp"
-
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <utility>
 
 namespace epochai {
+namespace {
+
+// Per-byte flags. Whitespace has none: it only ends a token.
+constexpr std::uint8_t kTokenByte = 0x1;     // extends the current token
+constexpr std::uint8_t kNonLetterByte = 0x2; // token byte that is not a letter
+constexpr std::uint8_t kPunctByte = 0x4;     // a token on its own
+
+// Same "C" locale classes as the tokenizer: whitespace ends a token, every
+// other ASCII non-alphanumeric byte is a token of its own, and everything
+// else, including UTF-8 bytes >= 0x80, extends the current token. Only
+// tokens made entirely of ASCII letters count as words.
+constexpr std::array<std::uint8_t, 256> make_byte_flags() {
+    std::array<std::uint8_t, 256> flags{};
+    for (int ch = 0; ch < 256; ++ch) {
+        const bool space = (ch >= 0x09 && ch <= 0x0D) || ch == ' ';
+        const bool letter = (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z');
+        const bool digit = ch >= '0' && ch <= '9';
+        const bool punct = ch >= 0x21 && ch <= 0x7E && !letter && !digit;
+        if (punct) {
+            flags[ch] = kPunctByte;
+        } else if (!space) {
+            flags[ch] = letter ? kTokenByte : kTokenByte | kNonLetterByte;
+        }
+    }
+    return flags;
+}
+
+constexpr auto kByteFlags = make_byte_flags();
+
+constexpr std::uint8_t byte_flags(char ch) {
+    return kByteFlags[static_cast<unsigned char>(ch)];
+}
+
+/// Below this many bytes per piece the fan-out costs more than it saves.
+constexpr std::size_t kMinBytesPerPiece = 256 * 1024;
 
-CountMetrics count_metrics(std::string_view text) {
-    CountMetrics metrics;
-    const auto tokens = tokenize(text);
-    metrics.tokens = static_cast<int>(tokens.size());
-
-    for (const auto& token : tokens) {
-        bool is_word = true;
-        int letter_count = 0;
-        for (char ch : token) {
-            if (std::isalpha(static_cast<unsigned char>(ch))) {
-                ++letter_count;
+/// Index of the first whitespace byte at or after `pos`, or `text.size()`.
+std::size_t next_space(std::string_view text, std::size_t pos) {
+    while (pos < text.size() && byte_flags(text[pos]) != 0) {
+        ++pos;
+    }
+    return pos;
+}
+
+} // namespace
+
+CountMetrics count_metrics(std::string_view text, bool record_words) {
+    MetricsCounter counter(record_words);
+    counter.feed(text);
+    return counter.finish();
+}
+
+CountMetrics count_metrics(std::string_view text, WorkerPool& pool, bool record_words) {
+    MetricsCounter counter(record_words);
+    counter.feed(text, pool);
+    return counter.finish();
+}
+
+void CountMetrics::merge(CountMetrics&& other) {
+    tokens += other.tokens;
+    word_count += other.word_count;
+    total_letters += other.total_letters;
+    letters_per_word.insert(letters_per_word.end(), other.letters_per_word.begin(), other.letters_per_word.end());
+    words.insert(words.end(), std::make_move_iterator(other.words.begin()),
+                 std::make_move_iterator(other.words.end()));
+}
+
+void MetricsCounter::feed(std::string_view chunk, WorkerPool& pool) {
+    const std::size_t max_pieces = std::min(pool.size(), chunk.size() / kMinBytesPerPiece);
+    const std::size_t first = max_pieces > 1 ? next_space(chunk, 0) : chunk.size();
+    std::size_t last = chunk.size();
+    while (last > first && byte_flags(chunk[last - 1]) != 0) {
+        --last;
+    }
+    if (last <= first + 1) {
+        feed(chunk);
+        return;
+    }
+    // The bytes up to and including the first whitespace finish any word the
+    // previous chunk left open; from there on no word crosses a piece
+    // boundary, because every piece ends just before a whitespace byte.
+    feed(chunk.substr(0, first + 1));
+    const auto middle = chunk.substr(first + 1, last - first - 1);
+    std::vector<std::size_t> bounds(max_pieces + 1, middle.size());
+    bounds[0] = 0;
+    for (std::size_t k = 1; k < max_pieces; ++k) {
+        bounds[k] = next_space(middle, std::max(bounds[k - 1], middle.size() * k / max_pieces));
+    }
+    std::vector<CountMetrics> pieces(max_pieces);
+    pool.parallel_for(max_pieces, [&](std::size_t k) {
+        MetricsCounter piece(record_words_);
+        piece.feed(middle.substr(bounds[k], bounds[k + 1] - bounds[k]));
+        pieces[k] = piece.finish();
+    });
+    for (auto& piece : pieces) {
+        metrics_.merge(std::move(piece));
+    }
+    feed(chunk.substr(last));
+}
+
+void MetricsCounter::feed(std::string_view chunk) {
+    if (record_words_) {
+        feed_recording(chunk);
+        return;
+    }
+    // Branch-free state machine: word boundaries in natural text are too
+    // irregular to predict, so every byte runs the same arithmetic and the
+    // counters stay in registers.
+    std::uint64_t tokens = 0;
+    std::uint64_t words = 0;
+    std::uint64_t letters = 0;
+    std::uint64_t in_word = in_word_ ? 1 : 0;
+    std::uint64_t tainted = all_letters_ ? 0 : 1;
+    std::uint64_t length = letters_;
+    for (const char ch : chunk) {
+        const std::uint64_t flags = byte_flags(ch);
+        const std::uint64_t inside = flags & kTokenByte;
+        const std::uint64_t ended = in_word & ~inside;
+        const std::uint64_t word_ended = ended & ~tainted;
+        tokens += ended + (flags >> 2);
+        words += word_ended;
+        letters += length & (0 - word_ended);
+        tainted = inside & (tainted | (flags >> 1));
+        length = (length + 1) & (0 - inside);
+        in_word = inside;
+    }
+    metrics_.tokens += tokens;
+    metrics_.word_count += words;
+    metrics_.total_letters += letters;
+    in_word_ = in_word != 0;
+    all_letters_ = tainted == 0;
+    letters_ = length;
+}
+
+void MetricsCounter::feed_recording(std::string_view chunk) {
+    for (const char ch : chunk) {
+        const std::uint8_t flags = byte_flags(ch);
+        if (flags & kTokenByte) {
+            in_word_ = true;
+            if (flags & kNonLetterByte) {
+                all_letters_ = false;
             } else {
-                is_word = false;
+                letters_ += 1;
+                if (all_letters_) {
+                    word_.push_back(ch);
+                }
             }
+            continue;
+        }
+        if (in_word_) {
+            close_word();
         }
-        if (is_word && !token.empty()) {
-            metrics.word_count += 1;
-            metrics.total_letters += letter_count;
-            metrics.letters_per_word.push_back(letter_count);
-            metrics.words.push_back(token);
+        if (flags & kPunctByte) {
+            metrics_.tokens += 1;
         }
     }
+}
 
-    return metrics;
+CountMetrics MetricsCounter::finish() {
+    if (in_word_) {
+        close_word();
+    }
+    return std::exchange(metrics_, CountMetrics{});
+}
+
+void MetricsCounter::close_word() {
+    metrics_.tokens += 1;
+    if (all_letters_) {
+        metrics_.word_count += 1;
+        metrics_.total_letters += letters_;
+        if (record_words_) {
+            metrics_.letters_per_word.push_back(letters_);
+            metrics_.words.push_back(std::move(word_));
+        }
+    }
+    word_.clear();
+    in_word_ = false;
+    all_letters_ = true;
+    letters_ = 0;
 }
 
 }
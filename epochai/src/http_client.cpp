@@ -1,13 +1,27 @@
 #include "epochai/http_client.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cerrno>
+#include <charconv>
 #include <chrono>
+#include <climits>
+#include <cstdint>
 #include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifdef _WIN32
@@ -16,15 +30,44 @@
 #pragma comment(lib, "Ws2_32.lib")
 #else
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
 #endif
 
 namespace epochai {
 namespace {
 
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle kInvalidSocket = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+constexpr SocketHandle kInvalidSocket = -1;
+#endif
+
+#ifdef MSG_NOSIGNAL
+// A pooled connection may have been reset by the server; writing to it must
+// fail with EPIPE rather than raise SIGPIPE.
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+/// Longest status line plus header block accepted from a server.
+constexpr std::size_t kMaxHeadBytes = 64 * 1024;
+
 struct ParsedUrl {
     std::string host;
     std::string port;
@@ -78,240 +121,1516 @@ struct WinsockInitializer {
 };
 #endif
 
-void set_socket_timeout(
+void close_socket(SocketHandle socket_fd) {
 #ifdef _WIN32
-    SOCKET socket_fd,
+    closesocket(socket_fd);
 #else
-    int socket_fd,
+    ::close(socket_fd);
 #endif
-    int timeout_ms) {
+}
+
+int last_socket_error() {
 #ifdef _WIN32
-    const DWORD timeout = static_cast<DWORD>(timeout_ms);
-    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
-    setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    return WSAGetLastError();
 #else
-    timeval tv{};
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return errno;
 #endif
 }
 
-bool send_all(
+bool would_block(int error) {
 #ifdef _WIN32
-    SOCKET socket_fd,
+    return error == WSAEWOULDBLOCK;
 #else
-    int socket_fd,
+    return error == EAGAIN || error == EWOULDBLOCK;
 #endif
-    const char* data,
-    std::size_t length) {
-    std::size_t sent_total = 0;
-    while (sent_total < length) {
-        int sent =
+}
+
+bool connect_pending(int error) {
 #ifdef _WIN32
-            ::send(socket_fd, data + sent_total, static_cast<int>(length - sent_total), 0);
+    return error == WSAEWOULDBLOCK;
 #else
-            static_cast<int>(::send(socket_fd, data + sent_total, length - sent_total, 0));
+    return error == EINPROGRESS;
 #endif
-        if (sent <= 0) {
-            return false;
-        }
-        sent_total += static_cast<std::size_t>(sent);
-    }
-    return true;
 }
 
-std::string receive_all(
+bool not_connected(int error) {
 #ifdef _WIN32
-    SOCKET socket_fd,
+    return error == WSAENOTCONN;
 #else
-    int socket_fd,
+    return error == ENOTCONN;
 #endif
-    bool& success) {
-    std::string data;
-    std::vector<char> buffer(4096);
-    success = true;
-    for (;;) {
-        int received =
+}
+
+bool set_nonblocking(SocketHandle socket_fd) {
 #ifdef _WIN32
-            ::recv(socket_fd, buffer.data(), static_cast<int>(buffer.size()), 0);
+    u_long mode = 1;
+    return ioctlsocket(socket_fd, FIONBIO, &mode) == 0;
 #else
-            static_cast<int>(::recv(socket_fd, buffer.data(), buffer.size(), 0));
+    const int flags = fcntl(socket_fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK) == 0;
 #endif
-        if (received > 0) {
-            data.append(buffer.data(), received);
-        } else if (received == 0) {
-            break;
-        } else {
-#ifdef _WIN32
-            int error_code = WSAGetLastError();
-            if (error_code == WSAETIMEDOUT) {
-                success = false;
-            }
+}
+
+/// One resolved address of a host.
+struct Endpoint {
+    sockaddr_storage address{};
+    socklen_t length = 0;
+    int family = AF_UNSPEC;
+};
+
+/// Resolve `host:port`, returning an empty list on failure. With
+/// `numeric_only` only address literals are accepted, which never blocks.
+std::vector<Endpoint> resolve(const std::string& host, const std::string& port, bool numeric_only) {
+    addrinfo hints{};
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_flags = numeric_only ? AI_NUMERICHOST : 0;
+
+    std::vector<Endpoint> endpoints;
+    addrinfo* info = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0) {
+        return endpoints;
+    }
+    for (addrinfo* current = info; current != nullptr; current = current->ai_next) {
+        Endpoint endpoint;
+        std::memcpy(&endpoint.address, current->ai_addr, current->ai_addrlen);
+        endpoint.length = static_cast<socklen_t>(current->ai_addrlen);
+        endpoint.family = current->ai_family;
+        endpoints.push_back(endpoint);
+    }
+    freeaddrinfo(info);
+    return endpoints;
+}
+
+/// Order `endpoints` for connection racing as RFC 8305 section 4 describes:
+/// address families alternate, starting with the family the resolver put
+/// first, and each family keeps the resolver's order.
+std::vector<Endpoint> interleave_families(const std::vector<Endpoint>& endpoints) {
+    std::vector<Endpoint> preferred;
+    std::vector<Endpoint> others;
+    for (const auto& endpoint : endpoints) {
+        (endpoint.family == endpoints.front().family ? preferred : others).push_back(endpoint);
+    }
+    std::vector<Endpoint> ordered;
+    ordered.reserve(endpoints.size());
+    for (std::size_t i = 0; i < std::max(preferred.size(), others.size()); ++i) {
+        if (i < preferred.size()) {
+            ordered.push_back(preferred[i]);
+        }
+        if (i < others.size()) {
+            ordered.push_back(others[i]);
+        }
+    }
+    return ordered;
+}
+
+/// Name lookups by `host:port`, each kept for a bounded time. A failed lookup
+/// is cached as an empty list under its own, shorter lifetime. Safe to use
+/// from any thread.
+class ResolverCache {
+public:
+    ResolverCache(std::chrono::milliseconds ttl, std::chrono::milliseconds negative_ttl)
+        : ttl_(ttl),
+          negative_ttl_(negative_ttl) {}
+
+    /// Endpoints cached for `key`, or nothing when the entry is missing or
+    /// expired.
+    std::optional<std::vector<Endpoint>> find(const std::string& key, Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto entry = entries_.find(key);
+        if (entry == entries_.end()) {
+            return std::nullopt;
+        }
+        if (now >= entry->second.expires) {
+            entries_.erase(entry);
+            return std::nullopt;
+        }
+        return entry->second.endpoints;
+    }
+
+    void store(const std::string& key, const std::vector<Endpoint>& endpoints, Clock::time_point now) {
+        const auto ttl = endpoints.empty() ? negative_ttl_ : ttl_;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ttl <= std::chrono::milliseconds::zero()) {
+            entries_.erase(key);
+            return;
+        }
+        entries_[key] = Entry{endpoints, now + ttl};
+    }
+
+    void invalidate(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.erase(key);
+    }
+
+private:
+    struct Entry {
+        std::vector<Endpoint> endpoints;
+        Clock::time_point expires;
+    };
+
+    const std::chrono::milliseconds ttl_;
+    const std::chrono::milliseconds negative_ttl_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+/// Readiness notification for the sockets of the event loop: epoll on Linux,
+/// poll elsewhere. `wake` may be called from any thread to cut a `wait`
+/// short.
+class Poller {
+public:
+    struct Ready {
+        SocketHandle socket;
+        bool readable;
+        bool writable;
+    };
+
+    Poller();
+    ~Poller();
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    /// Register `socket_fd` or replace its interest set.
+    bool watch(SocketHandle socket_fd, bool readable, bool writable);
+    void forget(SocketHandle socket_fd);
+
+    /// Block for up to `timeout_ms`, or indefinitely when negative, and fill
+    /// `ready`. Errors and hang-ups are reported as both readable and
+    /// writable so that the next read or write surfaces them.
+    void wait(int timeout_ms, std::vector<Ready>& ready);
+
+    void wake();
+
+private:
+#ifdef __linux__
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
 #else
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                success = false;
-            }
+    /// Self-connected loopback datagram socket; a byte sent to it wakes poll.
+    SocketHandle wake_socket_ = kInvalidSocket;
+    std::unordered_map<SocketHandle, short> interest_;
 #endif
-            break;
+};
+
+#ifdef __linux__
+Poller::Poller()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (epoll_fd_ < 0 || wake_fd_ < 0 || !watch(wake_fd_, true, false)) {
+        const int error_code = errno;
+        if (epoll_fd_ >= 0) {
+            ::close(epoll_fd_);
+        }
+        if (wake_fd_ >= 0) {
+            ::close(wake_fd_);
         }
+        throw std::system_error(error_code, std::generic_category(), "event loop setup failed");
     }
-    return data;
 }
 
-} // namespace
+Poller::~Poller() {
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+}
 
-HttpClient::HttpClient() {
+bool Poller::watch(SocketHandle socket_fd, bool readable, bool writable) {
+    epoll_event event{};
+    event.events = (readable ? EPOLLIN : 0u) | (writable ? EPOLLOUT : 0u);
+    event.data.fd = socket_fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket_fd, &event) == 0) {
+        return true;
+    }
+    return errno == ENOENT && epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket_fd, &event) == 0;
+}
+
+void Poller::forget(SocketHandle socket_fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd, nullptr);
+}
+
+void Poller::wait(int timeout_ms, std::vector<Ready>& ready) {
+    ready.clear();
+    std::array<epoll_event, 64> events;
+    const int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout_ms);
+    for (int i = 0; i < count; ++i) {
+        const auto& event = events[static_cast<std::size_t>(i)];
+        if (event.data.fd == wake_fd_) {
+            std::uint64_t value = 0;
+            [[maybe_unused]] const auto drained = ::read(wake_fd_, &value, sizeof(value));
+            continue;
+        }
+        const bool failed = (event.events & (EPOLLERR | EPOLLHUP)) != 0;
+        ready.push_back({event.data.fd, failed || (event.events & EPOLLIN) != 0,
+                         failed || (event.events & EPOLLOUT) != 0});
+    }
+}
+
+void Poller::wake() {
+    const std::uint64_t value = 1;
+    [[maybe_unused]] const auto written = ::write(wake_fd_, &value, sizeof(value));
+}
+#else
 #ifdef _WIN32
-    static WinsockInitializer initializer;
-#endif
+using PollEntry = WSAPOLLFD;
+
+int poll_sockets(PollEntry* entries, std::size_t count, int timeout_ms) {
+    return WSAPoll(entries, static_cast<ULONG>(count), timeout_ms);
+}
+#else
+using PollEntry = pollfd;
+
+int poll_sockets(PollEntry* entries, std::size_t count, int timeout_ms) {
+    return ::poll(entries, static_cast<nfds_t>(count), timeout_ms);
 }
+#endif
 
-HttpResult HttpClient::perform(const HttpRequest& request, int timeout_ms, int retries) const {
-    HttpResult final_result;
-    for (int attempt = 0; attempt <= std::max(0, retries); ++attempt) {
-        auto result = perform_once(request, timeout_ms);
-        if (result.success) {
-            return result;
+Poller::Poller()
+    : wake_socket_(::socket(AF_INET, SOCK_DGRAM, 0)) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (wake_socket_ == kInvalidSocket ||
+        ::bind(wake_socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::getsockname(wake_socket_, reinterpret_cast<sockaddr*>(&address), &length) != 0 ||
+        ::connect(wake_socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        !set_nonblocking(wake_socket_)) {
+        const int error_code = last_socket_error();
+        if (wake_socket_ != kInvalidSocket) {
+            close_socket(wake_socket_);
         }
-        final_result = result;
+        throw std::system_error(error_code, std::system_category(), "event loop setup failed");
     }
-    return final_result;
 }
 
-HttpResult HttpClient::perform_once(const HttpRequest& request, int timeout_ms) const {
-    HttpResult result;
-    ParsedUrl parsed;
-    if (!parse_url(request.url, parsed)) {
-        result.error_message = "Unsupported URL";
-        return result;
+Poller::~Poller() {
+    close_socket(wake_socket_);
+}
+
+bool Poller::watch(SocketHandle socket_fd, bool readable, bool writable) {
+    interest_[socket_fd] = static_cast<short>((readable ? POLLIN : 0) | (writable ? POLLOUT : 0));
+    return true;
+}
+
+void Poller::forget(SocketHandle socket_fd) {
+    interest_.erase(socket_fd);
+}
+
+void Poller::wait(int timeout_ms, std::vector<Ready>& ready) {
+    ready.clear();
+    std::vector<PollEntry> entries;
+    entries.reserve(interest_.size() + 1);
+    entries.push_back({wake_socket_, POLLIN, 0});
+    for (const auto& [socket_fd, events] : interest_) {
+        entries.push_back({socket_fd, events, 0});
     }
+    if (poll_sockets(entries.data(), entries.size(), timeout_ms) <= 0) {
+        return;
+    }
+    if (entries[0].revents != 0) {
+        char buffer[64];
+        while (::recv(wake_socket_, buffer, sizeof(buffer), 0) > 0) {
+        }
+    }
+    for (std::size_t i = 1; i < entries.size(); ++i) {
+        const auto revents = entries[i].revents;
+        if (revents == 0) {
+            continue;
+        }
+        const bool failed = (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+        ready.push_back({entries[i].fd, failed || (revents & POLLIN) != 0, failed || (revents & POLLOUT) != 0});
+    }
+}
 
-    addrinfo hints{};
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_family = AF_UNSPEC;
+void Poller::wake() {
+    const char byte = 0;
+    ::send(wake_socket_, &byte, 1, 0);
+}
+#endif
 
-    addrinfo* info = nullptr;
-    const auto lookup_status = getaddrinfo(parsed.host.c_str(), parsed.port.c_str(), &hints, &info);
-    if (lookup_status != 0) {
-        result.error_message = "DNS failure";
-        return result;
+char ascii_lower(char ch) {
+    return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+bool iequals(std::string_view lhs, std::string_view rhs) {
+    return std::ranges::equal(lhs, rhs, [](char a, char b) { return ascii_lower(a) == ascii_lower(b); });
+}
+
+std::string_view trim(std::string_view text) {
+    const auto first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+        return {};
     }
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
 
-    auto cleanup_info = [&]() {
-        if (info) {
-            freeaddrinfo(info);
-            info = nullptr;
+/// Whether the comma-separated header value `list` contains `token`.
+bool has_token(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        const auto comma = list.find(',');
+        if (iequals(trim(list.substr(0, comma)), token)) {
+            return true;
         }
-    };
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+    return false;
+}
 
-    auto start_time = std::chrono::steady_clock::now();
+/// Incremental HTTP/1.1 response reader.
+///
+/// Bytes are fed as they arrive. The body is framed by chunked transfer
+/// coding, then `Content-Length`, and only failing both by the server closing
+/// the connection, which is the one framing that forbids reuse.
+class ResponseParser {
+public:
+    explicit ResponseParser(bool head_request) : head_request_(head_request) {}
 
-#ifdef _WIN32
-    SOCKET socket_fd = INVALID_SOCKET;
-#else
-    int socket_fd = -1;
-#endif
+    /// Consume `data`; returns false once the response is malformed.
+    bool feed(std::string_view data);
 
-    for (addrinfo* current = info; current != nullptr; current = current->ai_next) {
-#ifdef _WIN32
-        socket_fd = ::socket(current->ai_family, current->ai_socktype, current->ai_protocol);
-        if (socket_fd == INVALID_SOCKET) {
-            continue;
+    /// The server closed the connection; returns whether that completes the
+    /// response.
+    bool close();
+
+    bool complete() const noexcept { return phase_ == Phase::complete; }
+
+    /// Whether the connection can carry another request: the response is
+    /// complete, nothing followed it and the server did not ask to close.
+    bool reusable() const noexcept { return complete() && keep_alive_ && buffer_.empty(); }
+
+    HttpResponse take_response() { return std::move(response_); }
+
+private:
+    enum class Phase { head, body, chunk_size, chunk_data, chunk_end, trailers, until_close, complete, failed };
+
+    bool parse_head(std::string_view head);
+    bool fail() {
+        phase_ = Phase::failed;
+        return false;
+    }
+
+    bool head_request_;
+    Phase phase_ = Phase::head;
+    bool keep_alive_ = false;
+    std::uint64_t remaining_ = 0;
+    std::string buffer_;
+    HttpResponse response_;
+};
+
+bool ResponseParser::feed(std::string_view data) {
+    if (phase_ == Phase::failed) {
+        return false;
+    }
+    buffer_.append(data);
+    std::size_t pos = 0;
+    for (bool progress = true; progress;) {
+        const std::string_view available = std::string_view(buffer_).substr(pos);
+        switch (phase_) {
+        case Phase::head: {
+            const auto end = available.find("\r\n\r\n");
+            if (end == std::string_view::npos) {
+                if (available.size() > kMaxHeadBytes) {
+                    return fail();
+                }
+                progress = false;
+                break;
+            }
+            pos += end + 4;
+            if (!parse_head(available.substr(0, end))) {
+                return fail();
+            }
+            break;
+        }
+        case Phase::body:
+        case Phase::chunk_data: {
+            const auto take = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, available.size()));
+            response_.body.append(available.substr(0, take));
+            pos += take;
+            remaining_ -= take;
+            if (remaining_ > 0) {
+                progress = false;
+            } else {
+                phase_ = phase_ == Phase::body ? Phase::complete : Phase::chunk_end;
+            }
+            break;
         }
-        set_socket_timeout(socket_fd, timeout_ms);
-        if (::connect(socket_fd, current->ai_addr, static_cast<int>(current->ai_addrlen)) == 0) {
+        case Phase::chunk_size: {
+            const auto end = available.find("\r\n");
+            if (end == std::string_view::npos) {
+                if (available.size() > kMaxHeadBytes) {
+                    return fail();
+                }
+                progress = false;
+                break;
+            }
+            // Chunk extensions after ';' carry nothing we use.
+            const auto line = trim(available.substr(0, std::min(end, available.find(';'))));
+            const auto parsed = std::from_chars(line.data(), line.data() + line.size(), remaining_, 16);
+            if (line.empty() || parsed.ec != std::errc{} || parsed.ptr != line.data() + line.size()) {
+                return fail();
+            }
+            pos += end + 2;
+            phase_ = remaining_ == 0 ? Phase::trailers : Phase::chunk_data;
             break;
         }
-        closesocket(socket_fd);
-        socket_fd = INVALID_SOCKET;
-#else
-        socket_fd = ::socket(current->ai_family, current->ai_socktype, current->ai_protocol);
-        if (socket_fd < 0) {
-            continue;
+        case Phase::chunk_end:
+            if (available.size() < 2) {
+                progress = false;
+            } else if (!available.starts_with("\r\n")) {
+                return fail();
+            } else {
+                pos += 2;
+                phase_ = Phase::chunk_size;
+            }
+            break;
+        case Phase::trailers: {
+            const auto end = available.find("\r\n");
+            if (end == std::string_view::npos) {
+                if (available.size() > kMaxHeadBytes) {
+                    return fail();
+                }
+                progress = false;
+                break;
+            }
+            pos += end + 2;
+            if (end == 0) {
+                phase_ = Phase::complete;
+            }
+            break;
         }
-        set_socket_timeout(socket_fd, timeout_ms);
-        if (::connect(socket_fd, current->ai_addr, current->ai_addrlen) == 0) {
+        case Phase::until_close:
+            response_.body.append(available);
+            pos = buffer_.size();
+            progress = false;
+            break;
+        case Phase::complete:
+        case Phase::failed:
+            progress = false;
             break;
         }
-        ::close(socket_fd);
-        socket_fd = -1;
-#endif
     }
+    buffer_.erase(0, pos);
+    return true;
+}
 
-    cleanup_info();
+bool ResponseParser::close() {
+    if (phase_ == Phase::until_close) {
+        phase_ = Phase::complete;
+    } else if (phase_ != Phase::complete) {
+        phase_ = Phase::failed;
+    }
+    return complete();
+}
 
-#ifdef _WIN32
-    if (socket_fd == INVALID_SOCKET) {
-        result.error_message = "Connection failed";
-        return result;
+bool ResponseParser::parse_head(std::string_view head) {
+    const auto line_end = std::min(head.find("\r\n"), head.size());
+    const auto status_line = head.substr(0, line_end);
+    if (status_line.size() < 12 || !status_line.starts_with("HTTP/1.") || status_line[8] != ' ') {
+        return false;
     }
-#else
-    if (socket_fd < 0) {
-        result.error_message = "Connection failed";
-        return result;
+    int status = 0;
+    const auto code = status_line.substr(9, 3);
+    const auto parsed = std::from_chars(code.data(), code.data() + code.size(), status);
+    if (parsed.ec != std::errc{} || parsed.ptr != code.data() + code.size() || status < 100) {
+        return false;
+    }
+    if (status < 200) {
+        // Interim responses precede the real one; 101 would switch protocols,
+        // which this client never asks for.
+        return status != 101;
+    }
+
+    bool keep_alive = status_line[7] == '1';
+    bool chunked = false;
+    bool encoded = false;
+    std::optional<std::uint64_t> content_length;
+    for (auto rest = head.substr(line_end); !rest.empty();) {
+        rest.remove_prefix(std::min<std::size_t>(2, rest.size()));
+        const auto line = rest.substr(0, rest.find("\r\n"));
+        rest.remove_prefix(line.size());
+        const auto colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        const auto name = trim(line.substr(0, colon));
+        const auto value = trim(line.substr(colon + 1));
+        if (iequals(name, "content-length")) {
+            std::uint64_t length = 0;
+            const auto result = std::from_chars(value.data(), value.data() + value.size(), length);
+            if (result.ec != std::errc{} || result.ptr != value.data() + value.size() ||
+                (content_length && *content_length != length)) {
+                return false;
+            }
+            content_length = length;
+        } else if (iequals(name, "transfer-encoding")) {
+            // Chunked must be the final coding whenever it is present at all.
+            const auto comma = value.rfind(',');
+            encoded = true;
+            chunked = iequals(trim(comma == std::string_view::npos ? value : value.substr(comma + 1)), "chunked");
+        } else if (iequals(name, "connection")) {
+            if (has_token(value, "close")) {
+                keep_alive = false;
+            } else if (has_token(value, "keep-alive")) {
+                keep_alive = true;
+            }
+        }
+    }
+
+    response_.status = status;
+    response_.headers = std::string(head);
+    keep_alive_ = keep_alive;
+    if (head_request_ || status == 204 || status == 304) {
+        phase_ = Phase::complete;
+    } else if (chunked) {
+        phase_ = Phase::chunk_size;
+    } else if (content_length && !encoded) {
+        remaining_ = *content_length;
+        phase_ = remaining_ == 0 ? Phase::complete : Phase::body;
+    } else {
+        keep_alive_ = false;
+        phase_ = Phase::until_close;
+    }
+    return true;
+}
+
+/// One request from submission until its future is satisfied.
+struct Transfer {
+    enum class Phase { waiting, resolving, connecting, sending, receiving, backoff };
+
+    std::uint64_t id = 0;
+    ParsedUrl url;
+    /// Pool key, `host:port`.
+    std::string key;
+    /// Serialized request.
+    std::string text;
+    bool head_request = false;
+    int timeout_ms = 0;
+    int retries_left = 0;
+    /// End of the overall budget, when the request has one.
+    std::optional<Clock::time_point> deadline;
+    int attempts = 0;
+    /// Outcome of the previous attempt while a retry is pending.
+    HttpResult last_result;
+    std::promise<HttpResult> promise;
+
+    // State of the current attempt.
+    Phase phase = Phase::waiting;
+    /// Whether this attempt is the half-open probe of its endpoint.
+    bool probe = false;
+    Clock::time_point attempt_start;
+    std::optional<Clock::time_point> expires;
+    /// Whether one of the host's connection slots is held.
+    bool holds_slot = false;
+    SocketHandle socket = kInvalidSocket;
+    bool reused = false;
+    bool received = false;
+    std::size_t sent = 0;
+    /// Resolution and connection must both finish by this time.
+    Clock::time_point connect_deadline;
+    std::vector<Endpoint> endpoints;
+    std::size_t next_endpoint = 0;
+    /// Connection attempts still racing, oldest first.
+    std::vector<SocketHandle> racing;
+    /// When the next endpoint joins the race unless an attempt fails first.
+    std::optional<Clock::time_point> next_attempt_at;
+    std::optional<ResponseParser> parser;
+};
+
+} // namespace
+
+std::string_view circuit_state_name(CircuitState state) noexcept {
+    switch (state) {
+    case CircuitState::closed:
+        return "closed";
+    case CircuitState::open:
+        return "open";
+    case CircuitState::half_open:
+        return "half_open";
+    }
+    return "closed";
+}
+
+/// Single-threaded reactor that owns every socket of an `HttpClient`.
+///
+/// Only `submit` and the destructor run on other threads; they hand work over
+/// through `mutex_` and wake the poller. Host names that are not address
+/// literals are resolved on helper threads so a slow lookup never stalls the
+/// loop, at most one lookup per `host:port` at a time, and the answers are
+/// cached.
+class HttpClient::EventLoop {
+public:
+    explicit EventLoop(HttpClientOptions options);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    std::future<HttpResult> submit(HttpRequest request, int timeout_ms, int retries, int deadline_ms);
+
+private:
+    struct Connection {
+        std::string key;
+        /// Transfer using the connection, or 0 while it idles in the pool.
+        std::uint64_t transfer = 0;
+        Clock::time_point idle_since;
+    };
+
+    struct Breaker {
+        CircuitState state = CircuitState::closed;
+        /// Consecutive failed attempts.
+        int failures = 0;
+        /// When an open circuit half-opens.
+        Clock::time_point half_open_at;
+        /// Whether the half-open probe is in flight.
+        bool probing = false;
+    };
+
+    struct Host {
+        /// Idle connections, most recently released last, so reuse picks the
+        /// warmest socket and the oldest ones age out.
+        std::vector<SocketHandle> idle;
+        /// Connection slots in use: busy plus idle connections, and attempts
+        /// still resolving or connecting.
+        std::size_t open = 0;
+        /// Transfers waiting for a slot, in arrival order.
+        std::deque<std::uint64_t> waiting;
+        Breaker breaker;
+    };
+
+    struct Resolution {
+        std::string key;
+        std::vector<Endpoint> endpoints;
+    };
+
+    void run();
+    void dispatch(const Poller::Ready& ready);
+    void shut_down();
+
+    void begin_attempt(Transfer& transfer);
+    void acquire(Transfer& transfer, bool reuse);
+    void start_resolve(Transfer& transfer);
+    void on_resolved(Resolution& resolution);
+    /// Race connections to `endpoints`, already in racing order.
+    void connect_to(Transfer& transfer, const std::vector<Endpoint>& endpoints);
+    bool start_connect_attempt(Transfer& transfer);
+    void on_connected(Transfer& transfer, SocketHandle socket_fd);
+    void on_connect_timer(Transfer& transfer, Clock::time_point now);
+    void continue_race(Transfer& transfer);
+    void abandon_race(Transfer& transfer);
+    void start_sending(Transfer& transfer);
+    void on_writable(Transfer& transfer);
+    void on_readable(Transfer& transfer);
+    void on_idle_readable(SocketHandle socket_fd);
+    void succeed(Transfer& transfer);
+    void attempt_failed(Transfer& transfer, std::string error, bool timed_out);
+    /// Release everything the current attempt holds.
+    void end_attempt(Transfer& transfer);
+    /// Schedule the next attempt after a backoff, or complete with `result`
+    /// when no retry is left or the backoff would overrun the deadline.
+    void retry_or_complete(Transfer& transfer, HttpResult result);
+    void complete(Transfer& transfer, HttpResult result);
+    std::chrono::milliseconds backoff_delay(int retry);
+
+    /// Whether the endpoint's circuit lets an attempt of `transfer` through.
+    bool admit(Transfer& transfer, Clock::time_point now);
+    /// Feed the outcome of an attempt that reached its endpoint to the
+    /// circuit breaker.
+    void record_outcome(Transfer& transfer, bool healthy);
+    /// Give up a half-open probe that ended without an outcome.
+    void forgo_probe(Transfer& transfer);
+
+    /// Put a connection that finished a response back into service.
+    void recycle(SocketHandle socket_fd);
+    /// Close a connection and give up its slot.
+    void discard(SocketHandle socket_fd);
+    void close_connection(SocketHandle socket_fd);
+    void release_slot(const std::string& key);
+    Transfer* next_waiter(Host& host);
+
+    void arm(Transfer& transfer, Clock::time_point when);
+    void disarm(Transfer& transfer);
+    void expire_timers(Clock::time_point now);
+    void evict_idle(Clock::time_point now);
+    int next_timeout_ms(Clock::time_point now) const;
+
+    HttpClientOptions options_;
+    Poller poller_;
+    // Locks itself; filled by the loop and by resolver tasks.
+    ResolverCache dns_cache_;
+
+    // Shared with submitting threads and resolver tasks.
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Transfer>> incoming_;
+    std::vector<Resolution> resolved_;
+    std::uint64_t next_id_ = 0;
+    bool stopping_ = false;
+
+    // Owned by the loop thread.
+    std::unordered_map<std::uint64_t, std::unique_ptr<Transfer>> transfers_;
+    std::unordered_map<SocketHandle, Connection> connections_;
+    std::unordered_map<std::string, Host> hosts_;
+    std::set<std::pair<Clock::time_point, std::uint64_t>> timers_;
+    std::vector<std::future<void>> resolvers_;
+    /// Transfers waiting for the lookup running for each `host:port`.
+    std::unordered_map<std::string, std::vector<std::uint64_t>> lookups_;
+    std::mt19937 jitter_{std::random_device{}()};
+
+    std::thread thread_;
+};
+
+HttpClient::EventLoop::EventLoop(HttpClientOptions options)
+    : options_(options),
+      dns_cache_(options.dns_ttl, options.dns_negative_ttl),
+      thread_([this]() { run(); }) {}
+
+HttpClient::EventLoop::~EventLoop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    poller_.wake();
+    thread_.join();
+    // Outstanding lookups still post their results; wait for them while the
+    // queue they post to exists.
+    resolvers_.clear();
+}
+
+std::future<HttpResult> HttpClient::EventLoop::submit(HttpRequest request, int timeout_ms, int retries,
+                                                      int deadline_ms) {
+    auto transfer = std::make_unique<Transfer>();
+    auto future = transfer->promise.get_future();
+    if (!parse_url(request.url, transfer->url)) {
+        HttpResult result;
+        result.error_message = "Unsupported URL";
+        transfer->promise.set_value(std::move(result));
+        return future;
     }
-#endif
 
     std::ostringstream request_stream;
-    request_stream << request.method << ' ' << parsed.path << " HTTP/1.1\r\n";
-    request_stream << "Host: " << parsed.host << "\r\n";
+    request_stream << request.method << ' ' << transfer->url.path << " HTTP/1.1\r\n";
+    request_stream << "Host: " << transfer->url.host << "\r\n";
     request_stream << "Content-Type: " << request.content_type << "\r\n";
     request_stream << "Accept: application/json\r\n";
-    request_stream << "Connection: close\r\n";
+    request_stream << "Connection: keep-alive\r\n";
     request_stream << "Content-Length: " << request.body.size() << "\r\n\r\n";
     request_stream << request.body;
-    const auto request_text = request_stream.str();
+    transfer->text = request_stream.str();
+    transfer->key = transfer->url.host + ':' + transfer->url.port;
+    transfer->head_request = request.method == "HEAD";
+    transfer->timeout_ms = timeout_ms;
+    transfer->retries_left = std::max(0, retries);
+    if (deadline_ms > 0) {
+        transfer->deadline = Clock::now() + std::chrono::milliseconds(deadline_ms);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        transfer->id = ++next_id_;
+        incoming_.push_back(std::move(transfer));
+    }
+    poller_.wake();
+    return future;
+}
+
+void HttpClient::EventLoop::run() {
+    std::vector<Poller::Ready> ready;
+    for (;;) {
+        std::vector<std::unique_ptr<Transfer>> incoming;
+        std::vector<Resolution> resolved;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                break;
+            }
+            incoming.swap(incoming_);
+            resolved.swap(resolved_);
+        }
+        for (auto& owned : incoming) {
+            auto& transfer = *owned;
+            transfers_.emplace(transfer.id, std::move(owned));
+            begin_attempt(transfer);
+        }
+        for (auto& resolution : resolved) {
+            on_resolved(resolution);
+        }
+        std::erase_if(resolvers_, [](const std::future<void>& lookup) {
+            return lookup.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
+
+        poller_.wait(next_timeout_ms(Clock::now()), ready);
+        for (const auto& event : ready) {
+            dispatch(event);
+        }
+        const auto now = Clock::now();
+        expire_timers(now);
+        evict_idle(now);
+    }
+    shut_down();
+}
+
+void HttpClient::EventLoop::dispatch(const Poller::Ready& ready) {
+    // Handlers tolerate spurious readiness: a socket closed earlier in this
+    // batch may already have been replaced by a new one with the same handle.
+    const auto connection = connections_.find(ready.socket);
+    if (connection == connections_.end()) {
+        return;
+    }
+    if (connection->second.transfer == 0) {
+        if (ready.readable) {
+            on_idle_readable(ready.socket);
+        }
+        return;
+    }
+    const auto owner = transfers_.find(connection->second.transfer);
+    if (owner == transfers_.end()) {
+        return;
+    }
+    auto& transfer = *owner->second;
+    switch (transfer.phase) {
+    case Transfer::Phase::connecting:
+        if (ready.writable) {
+            on_connected(transfer, ready.socket);
+        }
+        break;
+    case Transfer::Phase::sending:
+        if (ready.writable) {
+            on_writable(transfer);
+        }
+        break;
+    case Transfer::Phase::receiving:
+        if (ready.readable) {
+            on_readable(transfer);
+        }
+        break;
+    case Transfer::Phase::waiting:
+    case Transfer::Phase::resolving:
+    case Transfer::Phase::backoff:
+        break;
+    }
+}
+
+void HttpClient::EventLoop::shut_down() {
+    std::vector<std::unique_ptr<Transfer>> incoming;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        incoming.swap(incoming_);
+    }
+    HttpResult result;
+    result.error_message = "HTTP client shut down";
+    for (auto& transfer : incoming) {
+        transfer->promise.set_value(result);
+    }
+    for (auto& [id, transfer] : transfers_) {
+        transfer->promise.set_value(result);
+    }
+    transfers_.clear();
+    for (const auto& [socket_fd, connection] : connections_) {
+        poller_.forget(socket_fd);
+        close_socket(socket_fd);
+    }
+    connections_.clear();
+    hosts_.clear();
+    timers_.clear();
+}
+
+void HttpClient::EventLoop::begin_attempt(Transfer& transfer) {
+    const auto now = Clock::now();
+    if (!admit(transfer, now)) {
+        // A retry refused by the circuit reports what its last attempt saw;
+        // `HttpResult::circuit` tells why it stopped there.
+        HttpResult result = std::move(transfer.last_result);
+        if (transfer.attempts == 0) {
+            result.error_message = "Circuit open";
+        }
+        complete(transfer, std::move(result));
+        return;
+    }
+    ++transfer.attempts;
+    transfer.attempt_start = now;
+    acquire(transfer, true);
+}
+
+void HttpClient::EventLoop::acquire(Transfer& transfer, bool reuse) {
+    auto& host = hosts_[transfer.key];
+    transfer.reused = false;
+    if (reuse && !host.idle.empty()) {
+        const SocketHandle socket_fd = host.idle.back();
+        host.idle.pop_back();
+        connections_[socket_fd].transfer = transfer.id;
+        transfer.socket = socket_fd;
+        transfer.holds_slot = true;
+        transfer.reused = true;
+        start_sending(transfer);
+        return;
+    }
+    if (host.open < options_.max_connections_per_host) {
+        ++host.open;
+        transfer.holds_slot = true;
+        start_resolve(transfer);
+        return;
+    }
+    if (!host.idle.empty()) {
+        // A fresh connection is wanted and the host is at its cap: trade the
+        // oldest idle connection for it.
+        const SocketHandle oldest = host.idle.front();
+        host.idle.erase(host.idle.begin());
+        close_connection(oldest);
+        transfer.holds_slot = true;
+        start_resolve(transfer);
+        return;
+    }
+    transfer.phase = Transfer::Phase::waiting;
+    host.waiting.push_back(transfer.id);
+    arm(transfer, Clock::now() + std::chrono::milliseconds(transfer.timeout_ms));
+}
+
+void HttpClient::EventLoop::start_resolve(Transfer& transfer) {
+    transfer.phase = Transfer::Phase::resolving;
+    transfer.connect_deadline = Clock::now() + std::chrono::milliseconds(transfer.timeout_ms);
+    arm(transfer, transfer.connect_deadline);
+    const auto now = Clock::now();
+    if (const auto cached = dns_cache_.find(transfer.key, now)) {
+        connect_to(transfer, *cached);
+        return;
+    }
+    auto& waiters = lookups_[transfer.key];
+    waiters.push_back(transfer.id);
+    if (waiters.size() > 1) {
+        // The host is already being looked up; share its answer.
+        return;
+    }
+    auto endpoints = resolve(transfer.url.host, transfer.url.port, true);
+    if (!endpoints.empty()) {
+        Resolution resolution{transfer.key, interleave_families(endpoints)};
+        dns_cache_.store(resolution.key, resolution.endpoints, now);
+        on_resolved(resolution);
+        return;
+    }
+    resolvers_.push_back(std::async(std::launch::async, [this, key = transfer.key, host = transfer.url.host,
+                                                         port = transfer.url.port]() {
+        auto found = interleave_families(resolve(host, port, false));
+        dns_cache_.store(key, found, Clock::now());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            resolved_.push_back({key, std::move(found)});
+        }
+        poller_.wake();
+    }));
+}
+
+void HttpClient::EventLoop::on_resolved(Resolution& resolution) {
+    const auto waiters = lookups_.extract(resolution.key);
+    if (waiters.empty()) {
+        return;
+    }
+    for (const auto id : waiters.mapped()) {
+        // Waiters that timed out or were retried meanwhile are skipped.
+        const auto owner = transfers_.find(id);
+        if (owner != transfers_.end() && owner->second->phase == Transfer::Phase::resolving) {
+            connect_to(*owner->second, resolution.endpoints);
+        }
+    }
+}
+
+void HttpClient::EventLoop::connect_to(Transfer& transfer, const std::vector<Endpoint>& endpoints) {
+    if (endpoints.empty()) {
+        attempt_failed(transfer, "DNS failure", false);
+        return;
+    }
+    transfer.endpoints = endpoints;
+    transfer.next_endpoint = 0;
+    transfer.phase = Transfer::Phase::connecting;
+    continue_race(transfer);
+}
 
-    if (!send_all(socket_fd, request_text.c_str(), request_text.size())) {
+bool HttpClient::EventLoop::start_connect_attempt(Transfer& transfer) {
+    while (transfer.next_endpoint < transfer.endpoints.size()) {
+        const auto& endpoint = transfer.endpoints[transfer.next_endpoint++];
+        const SocketHandle socket_fd = ::socket(endpoint.family, SOCK_STREAM, IPPROTO_TCP);
+        if (socket_fd == kInvalidSocket) {
+            continue;
+        }
+        if (!set_nonblocking(socket_fd)) {
+            close_socket(socket_fd);
+            continue;
+        }
+        const int status = ::connect(socket_fd, reinterpret_cast<const sockaddr*>(&endpoint.address), endpoint.length);
+        if (status != 0 && !connect_pending(last_socket_error())) {
+            close_socket(socket_fd);
+            continue;
+        }
+        connections_[socket_fd] = Connection{transfer.key, transfer.id, {}};
+        if (!poller_.watch(socket_fd, false, true)) {
+            close_connection(socket_fd);
+            continue;
+        }
+        // Even an immediate success is reported through writability, which
+        // keeps a single completion path for every attempt.
+        transfer.racing.push_back(socket_fd);
+        return true;
+    }
+    return false;
+}
+
+void HttpClient::EventLoop::continue_race(Transfer& transfer) {
+    const bool started = start_connect_attempt(transfer);
+    if (!started && transfer.racing.empty()) {
+        // Every address refused; the host may have moved.
+        dns_cache_.invalidate(transfer.key);
+        attempt_failed(transfer, "Connection failed", false);
+        return;
+    }
+    transfer.next_attempt_at.reset();
+    if (transfer.next_endpoint < transfer.endpoints.size()) {
+        transfer.next_attempt_at = Clock::now() + options_.connection_attempt_delay;
+    }
+    arm(transfer, transfer.next_attempt_at ? std::min(*transfer.next_attempt_at, transfer.connect_deadline)
+                                           : transfer.connect_deadline);
+}
+
+void HttpClient::EventLoop::abandon_race(Transfer& transfer) {
+    for (const SocketHandle socket_fd : transfer.racing) {
+        close_connection(socket_fd);
+    }
+    transfer.racing.clear();
+    transfer.next_attempt_at.reset();
+}
+
+void HttpClient::EventLoop::on_connected(Transfer& transfer, SocketHandle socket_fd) {
+    int error_code = 0;
+    socklen_t length = sizeof(error_code);
+    getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error_code), &length);
+    if (error_code == 0) {
+        sockaddr_storage peer{};
+        length = sizeof(peer);
+        if (getpeername(socket_fd, reinterpret_cast<sockaddr*>(&peer), &length) == 0) {
+            // First connection wins; the losers are closed unused.
+            std::erase(transfer.racing, socket_fd);
+            abandon_race(transfer);
+            transfer.socket = socket_fd;
+            start_sending(transfer);
+            return;
+        }
+        if (not_connected(last_socket_error())) {
+            return;
+        }
+    }
+    // A failed attempt hands over to the next endpoint at once rather than
+    // after the attempt delay.
+    std::erase(transfer.racing, socket_fd);
+    close_connection(socket_fd);
+    continue_race(transfer);
+}
+
+void HttpClient::EventLoop::on_connect_timer(Transfer& transfer, Clock::time_point now) {
+    if (now >= transfer.connect_deadline) {
+        dns_cache_.invalidate(transfer.key);
+        attempt_failed(transfer, "Connect timeout", true);
+    } else {
+        continue_race(transfer);
+    }
+}
+
+void HttpClient::EventLoop::start_sending(Transfer& transfer) {
+    transfer.phase = Transfer::Phase::sending;
+    transfer.sent = 0;
+    transfer.received = false;
+    transfer.parser.emplace(transfer.head_request);
+    arm(transfer, Clock::now() + std::chrono::milliseconds(transfer.timeout_ms));
+    poller_.watch(transfer.socket, false, true);
+    on_writable(transfer);
+}
+
+void HttpClient::EventLoop::on_writable(Transfer& transfer) {
+    bool progressed = false;
+    while (transfer.sent < transfer.text.size()) {
+        const char* data = transfer.text.data() + transfer.sent;
+        const std::size_t length = transfer.text.size() - transfer.sent;
+        const auto sent =
 #ifdef _WIN32
-        closesocket(socket_fd);
+            ::send(transfer.socket, data, static_cast<int>(length), kSendFlags);
 #else
-        ::close(socket_fd);
+            ::send(transfer.socket, data, length, kSendFlags);
 #endif
-        result.error_message = "Send failed";
-        return result;
+        if (sent > 0) {
+            transfer.sent += static_cast<std::size_t>(sent);
+            progressed = true;
+        } else if (sent < 0 && would_block(last_socket_error())) {
+            if (progressed) {
+                arm(transfer, Clock::now() + std::chrono::milliseconds(transfer.timeout_ms));
+            }
+            return;
+        } else {
+            attempt_failed(transfer, "Send failed", false);
+            return;
+        }
     }
+    transfer.phase = Transfer::Phase::receiving;
+    arm(transfer, Clock::now() + std::chrono::milliseconds(transfer.timeout_ms));
+    poller_.watch(transfer.socket, true, false);
+}
 
-    bool receive_success = true;
-    const auto raw_response = receive_all(socket_fd, receive_success);
-
+void HttpClient::EventLoop::on_readable(Transfer& transfer) {
+    std::array<char, 16 * 1024> buffer;
+    bool progressed = false;
+    while (!transfer.parser->complete()) {
+        const auto count =
 #ifdef _WIN32
-    closesocket(socket_fd);
+            ::recv(transfer.socket, buffer.data(), static_cast<int>(buffer.size()), 0);
 #else
-    ::close(socket_fd);
+            ::recv(transfer.socket, buffer.data(), buffer.size(), 0);
 #endif
+        if (count > 0) {
+            transfer.received = true;
+            progressed = true;
+            if (!transfer.parser->feed(std::string_view(buffer.data(), static_cast<std::size_t>(count)))) {
+                attempt_failed(transfer, "Malformed HTTP response", false);
+                return;
+            }
+        } else if (count < 0 && would_block(last_socket_error())) {
+            if (progressed) {
+                arm(transfer, Clock::now() + std::chrono::milliseconds(transfer.timeout_ms));
+            }
+            return;
+        } else if (!transfer.parser->close()) {
+            attempt_failed(transfer, "Malformed HTTP response", false);
+            return;
+        }
+    }
+    succeed(transfer);
+}
+
+void HttpClient::EventLoop::on_idle_readable(SocketHandle socket_fd) {
+    char byte = 0;
+    if (::recv(socket_fd, &byte, 1, MSG_PEEK) < 0 && would_block(last_socket_error())) {
+        return;
+    }
+    // End of stream, a reset or unsolicited bytes: the server is done with
+    // this connection.
+    auto& idle = hosts_[connections_[socket_fd].key].idle;
+    std::erase(idle, socket_fd);
+    discard(socket_fd);
+}
+
+void HttpClient::EventLoop::succeed(Transfer& transfer) {
+    HttpResult result;
+    result.response = transfer.parser->take_response();
+    result.success = result.response.status >= 200 && result.response.status < 300;
+    if (!result.success) {
+        result.error_message = "HTTP status " + std::to_string(result.response.status);
+    }
+    result.latency = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - transfer.attempt_start);
 
-    result.latency = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - start_time);
+    const int status = result.response.status;
+    record_outcome(transfer, status < 500);
+    const bool reusable = transfer.parser->reusable();
+    const SocketHandle socket_fd = std::exchange(transfer.socket, kInvalidSocket);
+    transfer.holds_slot = false;
+    transfer.parser.reset();
+    disarm(transfer);
+    if (reusable) {
+        recycle(socket_fd);
+    } else {
+        discard(socket_fd);
+    }
+    if (status == 408 || status == 429 || status >= 500) {
+        retry_or_complete(transfer, std::move(result));
+    } else {
+        complete(transfer, std::move(result));
+    }
+}
 
-    if (!receive_success && raw_response.empty()) {
-        result.error_message = "Receive timeout";
-        return result;
+void HttpClient::EventLoop::attempt_failed(Transfer& transfer, std::string error, bool timed_out) {
+    // A pooled socket the server has already closed fails before any
+    // response byte arrives; only then is the request resent, once, over a
+    // fresh connection.
+    const bool stale = transfer.reused && !transfer.received && !timed_out;
+    if (!stale && transfer.phase != Transfer::Phase::waiting) {
+        record_outcome(transfer, false);
+    }
+    end_attempt(transfer);
+    if (stale) {
+        acquire(transfer, false);
+        return;
     }
+    HttpResult result;
+    result.error_message = std::move(error);
+    result.latency = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - transfer.attempt_start);
+    retry_or_complete(transfer, std::move(result));
+}
 
-    auto header_end = raw_response.find("\r\n\r\n");
-    if (header_end == std::string::npos) {
-        result.error_message = "Malformed HTTP response";
-        return result;
+void HttpClient::EventLoop::end_attempt(Transfer& transfer) {
+    disarm(transfer);
+    if (transfer.phase == Transfer::Phase::waiting) {
+        std::erase(hosts_[transfer.key].waiting, transfer.id);
+    }
+    abandon_race(transfer);
+    if (transfer.socket != kInvalidSocket) {
+        discard(std::exchange(transfer.socket, kInvalidSocket));
+    } else if (transfer.holds_slot) {
+        release_slot(transfer.key);
     }
-    const std::string header_text = raw_response.substr(0, header_end);
-    result.response.headers = header_text;
-    result.response.body = raw_response.substr(header_end + 4);
+    transfer.holds_slot = false;
+    transfer.parser.reset();
+}
 
-    auto line_end = header_text.find("\r\n");
-    std::string status_line = header_text.substr(0, line_end);
-    std::istringstream status_stream(status_line);
-    std::string http_version;
-    int status_code = 0;
-    status_stream >> http_version >> status_code;
-    result.response.status = status_code;
-    result.success = status_code >= 200 && status_code < 300;
-    if (!result.success && result.error_message.empty()) {
-        result.error_message = "HTTP status " + std::to_string(status_code);
+void HttpClient::EventLoop::retry_or_complete(Transfer& transfer, HttpResult result) {
+    forgo_probe(transfer);
+    if (transfer.retries_left > 0) {
+        const auto now = Clock::now();
+        const auto delay = backoff_delay(transfer.attempts - 1);
+        const auto& breaker = hosts_[transfer.key].breaker;
+        // Waiting out the backoff is pointless when the circuit will still
+        // refuse the retry afterwards.
+        const bool refused = breaker.state == CircuitState::open && now + delay < breaker.half_open_at;
+        if (!refused && (!transfer.deadline || now + delay < *transfer.deadline)) {
+            --transfer.retries_left;
+            transfer.last_result = std::move(result);
+            transfer.phase = Transfer::Phase::backoff;
+            arm(transfer, now + delay);
+            return;
+        }
     }
-    return result;
+    complete(transfer, std::move(result));
+}
+
+void HttpClient::EventLoop::complete(Transfer& transfer, HttpResult result) {
+    forgo_probe(transfer);
+    disarm(transfer);
+    const auto& breaker = hosts_[transfer.key].breaker;
+    result.attempts = transfer.attempts;
+    result.circuit = breaker.state == CircuitState::open && Clock::now() >= breaker.half_open_at
+                         ? CircuitState::half_open
+                         : breaker.state;
+    transfer.promise.set_value(std::move(result));
+    transfers_.erase(transfer.id);
+}
+
+std::chrono::milliseconds HttpClient::EventLoop::backoff_delay(int retry) {
+    auto ceiling = options_.retry_backoff_initial;
+    for (int i = 0; i < retry && ceiling < options_.retry_backoff_max; ++i) {
+        ceiling *= 2;
+    }
+    ceiling = std::min(ceiling, options_.retry_backoff_max);
+    if (ceiling.count() <= 0) {
+        return std::chrono::milliseconds(0);
+    }
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> pick(0, ceiling.count());
+    return std::chrono::milliseconds(pick(jitter_));
+}
+
+bool HttpClient::EventLoop::admit(Transfer& transfer, Clock::time_point now) {
+    auto& breaker = hosts_[transfer.key].breaker;
+    if (breaker.state == CircuitState::open && now >= breaker.half_open_at) {
+        breaker.state = CircuitState::half_open;
+        breaker.probing = false;
+    }
+    switch (breaker.state) {
+    case CircuitState::closed:
+        return true;
+    case CircuitState::open:
+        return false;
+    case CircuitState::half_open:
+        if (breaker.probing) {
+            return false;
+        }
+        breaker.probing = true;
+        transfer.probe = true;
+        return true;
+    }
+    return false;
+}
+
+void HttpClient::EventLoop::record_outcome(Transfer& transfer, bool healthy) {
+    auto& breaker = hosts_[transfer.key].breaker;
+    const bool probe = std::exchange(transfer.probe, false);
+    if (probe) {
+        breaker.probing = false;
+    }
+    if (healthy) {
+        breaker.state = CircuitState::closed;
+        breaker.failures = 0;
+        return;
+    }
+    ++breaker.failures;
+    // Attempts admitted before the circuit opened may still fail afterwards;
+    // they do not extend the cool-down.
+    if (probe || (breaker.state == CircuitState::closed && breaker.failures >= options_.circuit_failure_threshold)) {
+        breaker.state = CircuitState::open;
+        breaker.half_open_at = Clock::now() + options_.circuit_open_duration;
+    }
+}
+
+void HttpClient::EventLoop::forgo_probe(Transfer& transfer) {
+    if (std::exchange(transfer.probe, false)) {
+        hosts_[transfer.key].breaker.probing = false;
+    }
+}
+
+void HttpClient::EventLoop::recycle(SocketHandle socket_fd) {
+    auto& connection = connections_[socket_fd];
+    auto& host = hosts_[connection.key];
+    if (auto* waiter = next_waiter(host)) {
+        connection.transfer = waiter->id;
+        waiter->socket = socket_fd;
+        waiter->holds_slot = true;
+        waiter->reused = true;
+        start_sending(*waiter);
+        return;
+    }
+    connection.transfer = 0;
+    connection.idle_since = Clock::now();
+    host.idle.push_back(socket_fd);
+    poller_.watch(socket_fd, true, false);
+}
+
+void HttpClient::EventLoop::discard(SocketHandle socket_fd) {
+    const std::string key = connections_[socket_fd].key;
+    close_connection(socket_fd);
+    release_slot(key);
+}
+
+void HttpClient::EventLoop::close_connection(SocketHandle socket_fd) {
+    poller_.forget(socket_fd);
+    close_socket(socket_fd);
+    connections_.erase(socket_fd);
+}
+
+void HttpClient::EventLoop::release_slot(const std::string& key) {
+    auto& host = hosts_[key];
+    --host.open;
+    if (auto* waiter = next_waiter(host)) {
+        ++host.open;
+        waiter->holds_slot = true;
+        start_resolve(*waiter);
+    }
+}
+
+Transfer* HttpClient::EventLoop::next_waiter(Host& host) {
+    while (!host.waiting.empty()) {
+        const auto id = host.waiting.front();
+        host.waiting.pop_front();
+        const auto owner = transfers_.find(id);
+        if (owner != transfers_.end() && owner->second->phase == Transfer::Phase::waiting) {
+            return owner->second.get();
+        }
+    }
+    return nullptr;
+}
+
+void HttpClient::EventLoop::arm(Transfer& transfer, Clock::time_point when) {
+    disarm(transfer);
+    if (transfer.deadline) {
+        when = std::min(when, *transfer.deadline);
+    }
+    transfer.expires = when;
+    timers_.emplace(when, transfer.id);
+}
+
+void HttpClient::EventLoop::disarm(Transfer& transfer) {
+    if (transfer.expires) {
+        timers_.erase({*transfer.expires, transfer.id});
+        transfer.expires.reset();
+    }
+}
+
+void HttpClient::EventLoop::expire_timers(Clock::time_point now) {
+    while (!timers_.empty() && timers_.begin()->first <= now) {
+        const auto id = timers_.begin()->second;
+        timers_.erase(timers_.begin());
+        const auto owner = transfers_.find(id);
+        if (owner == transfers_.end()) {
+            continue;
+        }
+        auto& transfer = *owner->second;
+        transfer.expires.reset();
+        if (transfer.deadline && now >= *transfer.deadline) {
+            const bool on_the_wire =
+                transfer.phase != Transfer::Phase::waiting && transfer.phase != Transfer::Phase::backoff;
+            if (on_the_wire) {
+                record_outcome(transfer, false);
+            }
+            end_attempt(transfer);
+            HttpResult result;
+            result.error_message = "Deadline exceeded";
+            result.latency =
+                std::chrono::duration_cast<std::chrono::milliseconds>(now - transfer.attempt_start);
+            complete(transfer, std::move(result));
+            continue;
+        }
+        switch (transfer.phase) {
+        case Transfer::Phase::waiting:
+            attempt_failed(transfer, "Connection pool exhausted", true);
+            break;
+        case Transfer::Phase::sending:
+            attempt_failed(transfer, "Send failed", true);
+            break;
+        case Transfer::Phase::receiving:
+            attempt_failed(transfer, "Receive timeout", true);
+            break;
+        case Transfer::Phase::resolving:
+            attempt_failed(transfer, "DNS timeout", true);
+            break;
+        case Transfer::Phase::connecting:
+            on_connect_timer(transfer, now);
+            break;
+        case Transfer::Phase::backoff:
+            begin_attempt(transfer);
+            break;
+        }
+    }
+}
+
+void HttpClient::EventLoop::evict_idle(Clock::time_point now) {
+    for (auto& [key, host] : hosts_) {
+        while (!host.idle.empty() &&
+               now - connections_[host.idle.front()].idle_since >= options_.idle_timeout) {
+            close_connection(host.idle.front());
+            host.idle.erase(host.idle.begin());
+            --host.open;
+        }
+    }
+}
+
+int HttpClient::EventLoop::next_timeout_ms(Clock::time_point now) const {
+    std::optional<Clock::time_point> next;
+    if (!timers_.empty()) {
+        next = timers_.begin()->first;
+    }
+    for (const auto& [key, host] : hosts_) {
+        if (!host.idle.empty()) {
+            const auto expiry = connections_.at(host.idle.front()).idle_since + options_.idle_timeout;
+            next = next ? std::min(*next, expiry) : expiry;
+        }
+    }
+    if (!next) {
+        return -1;
+    }
+    if (*next <= now) {
+        return 0;
+    }
+    // Round up so the loop never wakes just before a deadline and spins.
+    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(*next - now).count();
+    return static_cast<int>(std::min<std::chrono::milliseconds::rep>(wait, INT_MAX));
+}
+
+HttpClient::HttpClient(HttpClientOptions options) {
+#ifdef _WIN32
+    static WinsockInitializer initializer;
+#endif
+    options.max_connections_per_host = std::max<std::size_t>(1, options.max_connections_per_host);
+    loop_ = std::make_unique<EventLoop>(options);
+}
+
+HttpClient::~HttpClient() = default;
+
+std::future<HttpResult> HttpClient::perform_async(HttpRequest request, int timeout_ms, int retries,
+                                                  int deadline_ms) const {
+    return loop_->submit(std::move(request), timeout_ms, retries, deadline_ms);
+}
+
+HttpResult HttpClient::perform(const HttpRequest& request, int timeout_ms, int retries, int deadline_ms) const {
+    return perform_async(request, timeout_ms, retries, deadline_ms).get();
 }
 
 } // namespace epochai
@@ -1,6 +1,7 @@
 #include "epochai/io_utils.hpp"
 
 #include <algorithm>
+#include <bit>
 #include <chrono>
 #include <climits>
 #include <cerrno>
@@ -10,6 +11,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 #ifdef _WIN32
@@ -17,9 +19,14 @@
 #include <io.h>
 #include <share.h>
 #include <sys/stat.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
 #else
 #include <cerrno>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -146,6 +153,88 @@ void FileIO::append_log(const std::filesystem::path& path, std::string_view cont
     }
 }
 
+AtomicFileWriter::AtomicFileWriter(std::filesystem::path path)
+    : path_(std::move(path)), temp_path_(path_.string() + ".tmp") {
+    const auto parent = path_.parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent);
+    }
+#ifdef _WIN32
+    fd_ = _open(temp_path_.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    if (fd_ == -1) {
+        throw std::system_error(errno, std::generic_category(), "_open failed");
+    }
+#else
+    fd_ = ::open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ == -1) {
+        throw std::system_error(errno, std::generic_category(), "open failed");
+    }
+#endif
+}
+
+AtomicFileWriter::~AtomicFileWriter() {
+    if (fd_ != -1) {
+#ifdef _WIN32
+        _close(fd_);
+        _unlink(temp_path_.c_str());
+#else
+        ::close(fd_);
+        ::unlink(temp_path_.c_str());
+#endif
+    }
+}
+
+void AtomicFileWriter::append(std::string_view data) {
+    write_all(fd_, data.data(), data.size());
+    size_ += data.size();
+}
+
+void AtomicFileWriter::write_at(std::uint64_t offset, std::string_view data) {
+    if (offset > size_ || data.size() > size_ - offset) {
+        throw std::out_of_range("AtomicFileWriter::write_at past the end of the file");
+    }
+#ifdef _WIN32
+    if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) == -1) {
+        throw std::system_error(errno, std::generic_category(), "_lseeki64 failed");
+    }
+    write_all(fd_, data.data(), data.size());
+    if (_lseeki64(fd_, 0, SEEK_END) == -1) {
+        throw std::system_error(errno, std::generic_category(), "_lseeki64 failed");
+    }
+#else
+    std::size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t result = ::pwrite(fd_, data.data() + written, data.size() - written,
+                                        static_cast<off_t>(offset + written));
+        if (result <= 0) {
+            throw std::system_error(errno, std::generic_category(), "pwrite failed");
+        }
+        written += static_cast<std::size_t>(result);
+    }
+#endif
+}
+
+void AtomicFileWriter::commit() {
+    fsync_fd(fd_);
+#ifdef _WIN32
+    _close(fd_);
+#else
+    ::close(fd_);
+#endif
+    fd_ = -1;
+    std::error_code ec;
+    std::filesystem::rename(temp_path_, path_, ec);
+    if (ec) {
+        std::filesystem::remove(path_, ec);
+        std::filesystem::rename(temp_path_, path_, ec);
+    }
+    if (ec) {
+        std::error_code ignored;
+        std::filesystem::remove(temp_path_, ignored);
+        throw std::system_error(ec);
+    }
+}
+
 std::string FileIO::read_file(const std::filesystem::path& path) {
     std::ifstream stream(path, std::ios::binary);
     if (!stream) {
@@ -168,6 +257,101 @@ std::optional<std::string> FileIO::try_read_file(const std::filesystem::path& pa
     }
 }
 
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "CreateFileW failed");
+    }
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size)) {
+        const auto error_code = static_cast<int>(GetLastError());
+        CloseHandle(file);
+        throw std::system_error(error_code, std::system_category(), "GetFileSizeEx failed");
+    }
+    if (size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const auto error_code = static_cast<int>(GetLastError());
+        CloseHandle(file);
+        if (mapping == nullptr) {
+            throw std::system_error(error_code, std::system_category(), "CreateFileMappingW failed");
+        }
+        const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            const auto view_error = static_cast<int>(GetLastError());
+            CloseHandle(mapping);
+            throw std::system_error(view_error, std::system_category(), "MapViewOfFile failed");
+        }
+        mapping_ = mapping;
+        data_ = static_cast<const char*>(view);
+        size_ = static_cast<std::size_t>(size.QuadPart);
+    } else {
+        CloseHandle(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "open failed");
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        int error_code = errno;
+        ::close(fd);
+        throw std::system_error(error_code, std::generic_category(), "fstat failed");
+    }
+    if (info.st_size > 0) {
+        void* view = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        int error_code = errno;
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            throw std::system_error(error_code, std::generic_category(), "mmap failed");
+        }
+        data_ = static_cast<const char*>(view);
+        size_ = static_cast<std::size_t>(info.st_size);
+    } else {
+        ::close(fd);
+    }
+#endif
+}
+
+MappedFile::~MappedFile() {
+    reset();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {
+#ifdef _WIN32
+    mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        reset();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::reset() noexcept {
+    if (data_ != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+#else
+        ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
 std::string format_utc_timestamp() {
     const auto now = std::chrono::system_clock::now();
     const auto time = std::chrono::system_clock::to_time_t(now);
@@ -188,4 +372,111 @@ std::string to_hex(std::uint64_t value) {
     return oss.str();
 }
 
+namespace {
+
+constexpr std::uint64_t kXxPrime1 = 0x9e3779b185ebca87ULL;
+constexpr std::uint64_t kXxPrime2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr std::uint64_t kXxPrime3 = 0x165667b19e3779f9ULL;
+constexpr std::uint64_t kXxPrime4 = 0x85ebca77c2b2ae63ULL;
+constexpr std::uint64_t kXxPrime5 = 0x27d4eb2f165667c5ULL;
+
+template <typename T>
+T read_le(const unsigned char* bytes) noexcept {
+    T value;
+    std::memcpy(&value, bytes, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) {
+        value = std::byteswap(value);
+    }
+    return value;
+}
+
+std::uint64_t xx_round(std::uint64_t lane, std::uint64_t input) noexcept {
+    lane += input * kXxPrime2;
+    return std::rotl(lane, 31) * kXxPrime1;
+}
+
+std::uint64_t xx_merge(std::uint64_t hash, std::uint64_t lane) noexcept {
+    hash ^= xx_round(0, lane);
+    return hash * kXxPrime1 + kXxPrime4;
+}
+
+void xx_stripe(std::uint64_t (&lanes)[4], const unsigned char* stripe) noexcept {
+    for (int i = 0; i < 4; ++i) {
+        lanes[i] = xx_round(lanes[i], read_le<std::uint64_t>(stripe + 8 * i));
+    }
+}
+
+} // namespace
+
+ContentHasher::ContentHasher(std::uint64_t seed) noexcept
+    : lanes_{seed + kXxPrime1 + kXxPrime2, seed + kXxPrime2, seed, seed - kXxPrime1}, seed_(seed), stripe_{} {}
+
+void ContentHasher::update(std::string_view data) noexcept {
+    auto input = reinterpret_cast<const unsigned char*>(data.data());
+    std::size_t size = data.size();
+    length_ += size;
+    if (buffered_ > 0) {
+        const std::size_t take = std::min(size, sizeof(stripe_) - buffered_);
+        std::memcpy(stripe_ + buffered_, input, take);
+        buffered_ += take;
+        input += take;
+        size -= take;
+        if (buffered_ < sizeof(stripe_)) {
+            return;
+        }
+        xx_stripe(lanes_, stripe_);
+        buffered_ = 0;
+    }
+    for (; size >= sizeof(stripe_); input += sizeof(stripe_), size -= sizeof(stripe_)) {
+        xx_stripe(lanes_, input);
+    }
+    if (size > 0) {
+        std::memcpy(stripe_, input, size);
+        buffered_ = size;
+    }
+}
+
+std::uint64_t ContentHasher::digest() const noexcept {
+    std::uint64_t hash;
+    if (length_ >= sizeof(stripe_)) {
+        hash = std::rotl(lanes_[0], 1) + std::rotl(lanes_[1], 7) + std::rotl(lanes_[2], 12) + std::rotl(lanes_[3], 18);
+        for (const auto lane : lanes_) {
+            hash = xx_merge(hash, lane);
+        }
+    } else {
+        hash = seed_ + kXxPrime5;
+    }
+    hash += length_;
+
+    const unsigned char* tail = stripe_;
+    std::size_t size = buffered_;
+    for (; size >= 8; tail += 8, size -= 8) {
+        hash ^= xx_round(0, read_le<std::uint64_t>(tail));
+        hash = std::rotl(hash, 27) * kXxPrime1 + kXxPrime4;
+    }
+    if (size >= 4) {
+        hash ^= read_le<std::uint32_t>(tail) * kXxPrime1;
+        hash = std::rotl(hash, 23) * kXxPrime2 + kXxPrime3;
+        tail += 4;
+        size -= 4;
+    }
+    for (; size > 0; ++tail, --size) {
+        hash ^= *tail * kXxPrime5;
+        hash = std::rotl(hash, 11) * kXxPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kXxPrime2;
+    hash ^= hash >> 29;
+    hash *= kXxPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::uint64_t content_hash(std::string_view data) noexcept {
+    ContentHasher hasher;
+    hasher.update(data);
+    return hasher.digest();
+}
+
 }
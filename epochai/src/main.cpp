@@ -1,11 +1,42 @@
 #include "epochai/app.hpp"
 
+#include <charconv>
+#include <cstddef>
 #include <exception>
 #include <iostream>
+#include <string_view>
 
-int main() {
+namespace {
+
+/// Parse a whole argument as a step count; trailing characters are rejected.
+bool parse_steps(std::string_view text, std::size_t& steps) {
+    const auto* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, steps);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    epochai::ApplicationOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        std::size_t steps = 0;
+        if (arg == "--evaluate-only") {
+            options.evaluate_only = true;
+        } else if (arg == "--daemon") {
+            options.steps = 0;
+        } else if (arg == "--steps" && i + 1 < argc && parse_steps(argv[i + 1], steps)) {
+            options.steps = steps;
+            ++i;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--evaluate-only | --daemon | --steps N (0 = --daemon)]"
+                      << std::endl;
+            return 2;
+        }
+    }
     try {
-        epochai::Application app;
+        epochai::Application app("state", options);
         return app.run();
     } catch (const std::exception& ex) {
         std::cerr << "EpochAI fatal error: " << ex.what() << std::endl;
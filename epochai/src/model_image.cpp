@@ -0,0 +1,258 @@
+#include "epochai/model_image.hpp"
+
+#include "epochai/io_utils.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace epochai {
+namespace {
+
+static_assert(std::endian::native == std::endian::little, "model images are little-endian");
+
+constexpr char kModelImageMagic[8] = {'E', 'P', 'A', 'I', 'M', 'D', 'L', '\0'};
+
+constexpr std::size_t align8(std::size_t value) {
+    return (value + 7) & ~std::size_t{7};
+}
+
+/// Byte offsets of every section for the given element counts.
+struct SectionLayout {
+    std::size_t vocab_offsets = 0;
+    std::size_t token_index = 0;
+    std::size_t row_offsets = 0;
+    std::size_t next_ids = 0;
+    std::size_t counts = 0;
+    std::size_t totals = 0;
+    std::size_t strings = 0;
+    std::size_t end = 0;
+};
+
+SectionLayout compute_layout(std::uint64_t vocab_size, std::uint64_t transition_count, std::uint64_t string_bytes) {
+    SectionLayout layout;
+    layout.vocab_offsets = sizeof(ModelImageHeader);
+    layout.token_index = layout.vocab_offsets + (vocab_size + 1) * sizeof(std::uint64_t);
+    layout.row_offsets = align8(layout.token_index + vocab_size * sizeof(TokenId));
+    layout.next_ids = layout.row_offsets + (vocab_size + 1) * sizeof(std::uint64_t);
+    layout.counts = align8(layout.next_ids + transition_count * sizeof(TokenId));
+    layout.totals = layout.counts + transition_count * sizeof(double);
+    layout.strings = layout.totals + vocab_size * sizeof(double);
+    layout.end = align8(layout.strings + string_bytes);
+    return layout;
+}
+
+std::uint64_t image_checksum(std::string_view image) {
+    constexpr std::size_t checksum_offset = offsetof(ModelImageHeader, checksum);
+    constexpr char zero[sizeof(std::uint64_t)] = {};
+    ContentHasher hasher;
+    hasher.update(image.substr(0, checksum_offset));
+    hasher.update(std::string_view(zero, sizeof(zero)));
+    hasher.update(image.substr(checksum_offset + sizeof(zero)));
+    return hasher.digest();
+}
+
+template <typename T>
+std::span<const T> section(std::string_view image, std::size_t offset, std::size_t count) {
+    return {reinterpret_cast<const T*>(image.data() + offset), count};
+}
+
+template <typename T>
+void write_section(std::string& image, std::size_t offset, const std::vector<T>& values) {
+    if (!values.empty()) {
+        std::memcpy(image.data() + offset, values.data(), values.size() * sizeof(T));
+    }
+}
+
+/// Ensure `offsets` starts at 0, never decreases and ends at `limit`.
+void check_offsets(std::span<const std::uint64_t> offsets, std::uint64_t limit, const char* what) {
+    if (offsets.front() != 0 || offsets.back() != limit ||
+        std::adjacent_find(offsets.begin(), offsets.end(), std::greater<>()) != offsets.end()) {
+        throw std::runtime_error(std::string("Model image has malformed ") + what);
+    }
+}
+
+} // namespace
+
+std::string encode_model_image(const ModelState& state) {
+    const std::size_t vocab_size = state.vocab.size();
+    const auto entries = state.transitions.sorted_entries();
+
+    std::vector<std::uint64_t> vocab_offsets(vocab_size + 1, 0);
+    for (std::size_t id = 0; id < vocab_size; ++id) {
+        vocab_offsets[id + 1] = vocab_offsets[id] + state.vocab[static_cast<TokenId>(id)].size();
+    }
+    std::vector<TokenId> token_index(vocab_size);
+    std::iota(token_index.begin(), token_index.end(), TokenId{0});
+    std::sort(token_index.begin(), token_index.end(), [&](TokenId lhs, TokenId rhs) {
+        return std::string_view(state.vocab[lhs]) < std::string_view(state.vocab[rhs]);
+    });
+
+    std::vector<std::uint64_t> row_offsets(vocab_size + 1, 0);
+    std::vector<TokenId> next_ids;
+    std::vector<double> counts;
+    next_ids.reserve(entries.size());
+    counts.reserve(entries.size());
+    for (const auto& entry : entries) {
+        row_offsets[entry.prev + 1] += 1;
+        next_ids.push_back(entry.next);
+        counts.push_back(entry.count);
+    }
+    std::partial_sum(row_offsets.begin(), row_offsets.end(), row_offsets.begin());
+
+    std::vector<double> totals(vocab_size);
+    for (std::size_t id = 0; id < vocab_size; ++id) {
+        totals[id] = state.transitions.total(static_cast<TokenId>(id));
+    }
+
+    const auto layout = compute_layout(vocab_size, entries.size(), vocab_offsets.back());
+    std::string image(layout.end, '\0');
+
+    ModelImageHeader header{};
+    std::memcpy(header.magic, kModelImageMagic, sizeof(header.magic));
+    header.version = kModelImageVersion;
+    header.header_size = sizeof(ModelImageHeader);
+    header.step = state.step;
+    header.vocab_size = vocab_size;
+    header.transition_count = entries.size();
+    header.string_bytes = vocab_offsets.back();
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    write_section(image, layout.vocab_offsets, vocab_offsets);
+    write_section(image, layout.token_index, token_index);
+    write_section(image, layout.row_offsets, row_offsets);
+    write_section(image, layout.next_ids, next_ids);
+    write_section(image, layout.counts, counts);
+    write_section(image, layout.totals, totals);
+    char* strings = image.data() + layout.strings;
+    for (const auto& token : state.vocab) {
+        std::memcpy(strings, token.data(), token.size());
+        strings += token.size();
+    }
+
+    header.checksum = image_checksum(image);
+    std::memcpy(image.data() + offsetof(ModelImageHeader, checksum), &header.checksum, sizeof(header.checksum));
+    return image;
+}
+
+ModelImageView parse_model_image(std::string_view image, ModelImageCheck check) {
+    if (image.size() < sizeof(ModelImageHeader)) {
+        throw std::runtime_error("Model image is truncated");
+    }
+    if (reinterpret_cast<std::uintptr_t>(image.data()) % alignof(std::uint64_t) != 0) {
+        throw std::runtime_error("Model image is not 8-byte aligned");
+    }
+    ModelImageHeader header;
+    std::memcpy(&header, image.data(), sizeof(header));
+    if (std::memcmp(header.magic, kModelImageMagic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Model image has an unknown signature");
+    }
+    if (header.version != kModelImageVersion || header.header_size != sizeof(ModelImageHeader)) {
+        throw std::runtime_error("Unsupported model image version " + std::to_string(header.version));
+    }
+    // Reject counts whose sections could not fit before computing offsets, so
+    // the layout arithmetic cannot overflow.
+    if (header.vocab_size >= image.size() || header.transition_count >= image.size() ||
+        header.string_bytes >= image.size() || header.vocab_size >= std::numeric_limits<TokenId>::max()) {
+        throw std::runtime_error("Model image is truncated");
+    }
+    const auto layout = compute_layout(header.vocab_size, header.transition_count, header.string_bytes);
+    if (layout.end != image.size()) {
+        throw std::runtime_error("Model image is truncated");
+    }
+    const bool full = check == ModelImageCheck::full;
+    if (full && image_checksum(image) != header.checksum) {
+        throw std::runtime_error("Model image checksum mismatch");
+    }
+
+    ModelImageView view;
+    view.step = header.step;
+    view.vocab_offsets = section<std::uint64_t>(image, layout.vocab_offsets, header.vocab_size + 1);
+    view.token_index = section<TokenId>(image, layout.token_index, header.vocab_size);
+    view.row_offsets = section<std::uint64_t>(image, layout.row_offsets, header.vocab_size + 1);
+    view.next_ids = section<TokenId>(image, layout.next_ids, header.transition_count);
+    view.counts = section<double>(image, layout.counts, header.transition_count);
+    view.totals = section<double>(image, layout.totals, header.vocab_size);
+    view.strings = image.substr(layout.strings, header.string_bytes);
+    if (!full) {
+        return view;
+    }
+
+    check_offsets(view.vocab_offsets, header.string_bytes, "vocabulary offsets");
+    check_offsets(view.row_offsets, header.transition_count, "transition rows");
+    const auto out_of_range = [&](TokenId id) { return id >= header.vocab_size; };
+    if (std::any_of(view.next_ids.begin(), view.next_ids.end(), out_of_range) ||
+        std::any_of(view.token_index.begin(), view.token_index.end(), out_of_range)) {
+        throw std::runtime_error("Model image references an unknown token");
+    }
+    return view;
+}
+
+ModelState decode_model_image(std::string_view image) {
+    const auto view = parse_model_image(image);
+    ModelState state;
+    state.step = static_cast<int>(view.step);
+    state.vocab.reserve(view.vocab_size());
+    for (std::size_t id = 0; id < view.vocab_size(); ++id) {
+        if (state.vocab.intern(view.token(static_cast<TokenId>(id))) != id) {
+            throw std::runtime_error("Model image has duplicate vocabulary entries");
+        }
+    }
+    state.transitions.reserve(view.next_ids.size());
+    for (std::size_t prev = 0; prev < view.vocab_size(); ++prev) {
+        for (std::uint64_t i = view.row_offsets[prev]; i < view.row_offsets[prev + 1]; ++i) {
+            state.transitions.set_count(static_cast<TokenId>(prev), view.next_ids[i], view.counts[i]);
+        }
+        if (view.totals[prev] != 0.0) {
+            state.transitions.set_total(static_cast<TokenId>(prev), view.totals[prev]);
+        }
+    }
+    return state;
+}
+
+MappedModel::MappedModel(const std::filesystem::path& path)
+    : file_(path), view_(parse_model_image(file_.bytes(), ModelImageCheck::header)) {}
+
+std::optional<TokenId> MappedModel::find(std::string_view token) const noexcept {
+    const auto it = std::lower_bound(view_.token_index.begin(), view_.token_index.end(), token,
+                                     [&](TokenId id, std::string_view value) { return this->token(id) < value; });
+    if (it == view_.token_index.end() || this->token(*it) != token) {
+        return std::nullopt;
+    }
+    return *it;
+}
+
+std::string_view MappedModel::token(TokenId id) const noexcept {
+    if (id >= view_.vocab_size()) {
+        return {};
+    }
+    const std::size_t last = std::min<std::uint64_t>(view_.vocab_offsets[id + 1], view_.strings.size());
+    const std::size_t first = std::min<std::uint64_t>(view_.vocab_offsets[id], last);
+    return view_.strings.substr(first, last - first);
+}
+
+double MappedModel::count(TokenId prev, TokenId next) const noexcept {
+    if (prev >= view_.vocab_size()) {
+        return 0.0;
+    }
+    const std::size_t last = std::min<std::uint64_t>(view_.row_offsets[prev + 1], view_.next_ids.size());
+    const std::size_t first = std::min<std::uint64_t>(view_.row_offsets[prev], last);
+    const auto row = view_.next_ids.subspan(first, last - first);
+    const auto it = std::lower_bound(row.begin(), row.end(), next);
+    if (it == row.end() || *it != next) {
+        return 0.0;
+    }
+    return view_.counts[first + static_cast<std::size_t>(it - row.begin())];
+}
+
+double MappedModel::total(TokenId prev) const noexcept {
+    return prev < view_.vocab_size() ? view_.totals[prev] : 0.0;
+}
+
+}
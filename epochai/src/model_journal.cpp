@@ -0,0 +1,303 @@
+#include "epochai/model_journal.hpp"
+
+#include "epochai/io_utils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace epochai {
+namespace {
+
+constexpr std::uint32_t kJournalMagic = 0x324a5045; // "EPJ2"
+/// Records checksummed with byte-serial FNV-1a; refused rather than read as
+/// torn.
+constexpr std::uint32_t kLegacyJournalMagic = 0x314a5045; // "EPJ1"
+constexpr std::string_view kSegmentExtension = ".log";
+
+struct JournalRecordHeader {
+    std::uint32_t magic;
+    std::uint32_t reserved;
+    std::int64_t step;
+    std::uint64_t first_new_token;
+    std::uint64_t new_token_count;
+    std::uint64_t transition_count;
+    std::uint64_t total_count;
+    std::uint64_t payload_bytes;
+    std::uint64_t checksum;
+};
+static_assert(sizeof(JournalRecordHeader) == 64);
+
+struct TransitionRecord {
+    TokenId prev;
+    TokenId next;
+    double delta;
+};
+
+struct TotalRecord {
+    TokenId prev;
+    std::uint32_t reserved;
+    double total;
+};
+
+template <typename T>
+void append_pod(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/// Bounds-checked sequential reader over one record payload.
+class PayloadReader {
+public:
+    explicit PayloadReader(std::string_view data)
+        : data_(data) {}
+
+    template <typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view take(std::size_t size) {
+        if (size > data_.size()) {
+            throw std::runtime_error("Journal record payload is truncated");
+        }
+        const auto bytes = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return bytes;
+    }
+
+    bool done() const noexcept { return data_.empty(); }
+
+private:
+    std::string_view data_;
+};
+
+std::string encode_record(const ModelDelta& delta) {
+    std::string payload;
+    for (const auto& token : delta.new_tokens) {
+        append_pod(payload, static_cast<std::uint32_t>(token.size()));
+        payload += token;
+    }
+    for (const auto& entry : delta.transitions) {
+        append_pod(payload, TransitionRecord{entry.prev, entry.next, entry.count});
+    }
+    for (const auto& [prev, total] : delta.totals) {
+        append_pod(payload, TotalRecord{prev, 0, total});
+    }
+
+    JournalRecordHeader header{};
+    header.magic = kJournalMagic;
+    header.step = delta.step;
+    header.first_new_token = delta.first_new_token;
+    header.new_token_count = delta.new_tokens.size();
+    header.transition_count = delta.transitions.size();
+    header.total_count = delta.totals.size();
+    header.payload_bytes = payload.size();
+    header.checksum = content_hash(payload);
+
+    std::string record;
+    record.reserve(sizeof(header) + payload.size());
+    append_pod(record, header);
+    record += payload;
+    return record;
+}
+
+/// Apply one validated record to `state`.
+void apply_record(ModelState& state, const JournalRecordHeader& header, std::string_view payload) {
+    if (header.first_new_token != state.vocab.size()) {
+        throw std::runtime_error("Journal record does not continue the model vocabulary");
+    }
+    PayloadReader reader(payload);
+    for (std::uint64_t i = 0; i < header.new_token_count; ++i) {
+        const auto length = reader.read<std::uint32_t>();
+        state.vocab.intern(reader.take(length));
+    }
+    if (state.vocab.size() != header.first_new_token + header.new_token_count) {
+        throw std::runtime_error("Journal record repeats a known token");
+    }
+    const std::size_t vocab_size = state.vocab.size();
+    for (std::uint64_t i = 0; i < header.transition_count; ++i) {
+        const auto record = reader.read<TransitionRecord>();
+        if (record.prev >= vocab_size || record.next >= vocab_size) {
+            throw std::runtime_error("Journal record references an unknown token");
+        }
+        state.transitions.set_count(record.prev, record.next,
+                                    state.transitions.count(record.prev, record.next) + record.delta);
+    }
+    for (std::uint64_t i = 0; i < header.total_count; ++i) {
+        const auto record = reader.read<TotalRecord>();
+        if (record.prev >= vocab_size) {
+            throw std::runtime_error("Journal record references an unknown token");
+        }
+        state.transitions.set_total(record.prev, record.total);
+    }
+    if (!reader.done()) {
+        throw std::runtime_error("Journal record has trailing bytes");
+    }
+    state.step = static_cast<int>(header.step);
+}
+
+std::uint64_t segment_number(const std::filesystem::path& path) {
+    const auto stem = path.stem().string();
+    std::uint64_t number = 0;
+    const auto [ptr, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), number);
+    if (ec != std::errc() || ptr != stem.data() + stem.size() || path.extension() != kSegmentExtension) {
+        return 0;
+    }
+    return number;
+}
+
+std::filesystem::path segment_path(const std::filesystem::path& directory, std::uint64_t number) {
+    char name[32];
+    const auto result = std::to_chars(name, name + sizeof(name), number);
+    std::string stem(name, result.ptr);
+    stem.insert(0, 16 - std::min<std::size_t>(stem.size(), 16), '0');
+    return directory / (stem + std::string(kSegmentExtension));
+}
+
+} // namespace
+
+ModelDelta make_model_delta(const ModelState& state, std::size_t first_new_token, const TransitionCounts& applied) {
+    ModelDelta delta;
+    delta.step = state.step;
+    delta.first_new_token = first_new_token;
+    for (std::size_t id = first_new_token; id < state.vocab.size(); ++id) {
+        delta.new_tokens.push_back(state.vocab[static_cast<TokenId>(id)]);
+    }
+    delta.transitions = applied.pairs.sorted_entries();
+    for (const auto& entry : delta.transitions) {
+        if (delta.totals.empty() || delta.totals.back().first != entry.prev) {
+            delta.totals.emplace_back(entry.prev, state.transitions.total(entry.prev));
+        }
+    }
+    return delta;
+}
+
+ModelJournal::ModelJournal(std::filesystem::path directory)
+    : directory_(std::move(directory)) {}
+
+void ModelJournal::append(const ModelDelta& delta) {
+    auto existing = segments();
+    const auto path = existing.empty() ? segment_path(directory_, 1) : existing.back();
+    FileIO::append_log(path, encode_record(delta));
+}
+
+std::vector<std::filesystem::path> ModelJournal::segments() const {
+    std::vector<std::filesystem::path> result;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+        if (entry.is_regular_file() && segment_number(entry.path()) != 0) {
+            result.push_back(entry.path());
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+        return segment_number(lhs) < segment_number(rhs);
+    });
+    return result;
+}
+
+std::uintmax_t ModelJournal::size_bytes() const {
+    std::uintmax_t total = 0;
+    for (const auto& path : segments()) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(path, ec);
+        total += ec ? 0 : size;
+    }
+    return total;
+}
+
+std::vector<std::filesystem::path> ModelJournal::seal() {
+    auto sealed = segments();
+    if (sealed.empty()) {
+        return sealed;
+    }
+    FileIO::atomic_write(segment_path(directory_, segment_number(sealed.back()) + 1), {});
+    return sealed;
+}
+
+std::size_t ModelJournal::replay(ModelState& state, const std::vector<std::filesystem::path>& segments,
+                                 bool repair) const {
+    std::size_t applied = 0;
+    for (std::size_t s = 0; s < segments.size(); ++s) {
+        const bool newest = s + 1 == segments.size();
+        const auto content = FileIO::read_file(segments[s]);
+        std::string_view remaining = content;
+        while (!remaining.empty()) {
+            JournalRecordHeader header{};
+            bool intact = remaining.size() >= sizeof(header);
+            if (intact) {
+                std::memcpy(&header, remaining.data(), sizeof(header));
+                if (header.magic == kLegacyJournalMagic) {
+                    throw std::runtime_error("Unsupported journal record format in " + segments[s].string());
+                }
+                intact = header.magic == kJournalMagic && header.payload_bytes <= remaining.size() - sizeof(header);
+            }
+            const auto payload = intact ? remaining.substr(sizeof(header), header.payload_bytes) : std::string_view{};
+            if (intact && content_hash(payload) != header.checksum) {
+                intact = false;
+            }
+            if (!intact) {
+                if (!newest) {
+                    throw std::runtime_error("Corrupt journal segment: " + segments[s].string());
+                }
+                // A crash interrupted the last append; drop the partial record
+                // so new records are not written behind it.
+                if (repair) {
+                    std::filesystem::resize_file(segments[s], content.size() - remaining.size());
+                }
+                break;
+            }
+            if (header.step > state.step) {
+                apply_record(state, header, payload);
+                applied += 1;
+            }
+            remaining.remove_prefix(sizeof(header) + header.payload_bytes);
+        }
+    }
+    return applied;
+}
+
+JournalCompactor::JournalCompactor(StateManager& manager)
+    : manager_(manager) {}
+
+JournalCompactor::~JournalCompactor() {
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+bool JournalCompactor::start_if_due(std::uintmax_t threshold_bytes) {
+    if (pending_.valid()) {
+        if (pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+        // Reap the finished compaction, surfacing its failure to the caller.
+        pending_.get();
+    }
+    const auto bytes = manager_.model_journal_bytes();
+    if (bytes == 0 || bytes < threshold_bytes) {
+        return false;
+    }
+    // Sealing happens here so appends made after this call land in the new
+    // segment, which the background fold never touches.
+    auto sealed = manager_.seal_model_journal();
+    pending_ = std::async(std::launch::async, [this, sealed = std::move(sealed)]() {
+        manager_.compact_model_journal(sealed);
+    });
+    return true;
+}
+
+bool JournalCompactor::wait() {
+    if (!pending_.valid()) {
+        return false;
+    }
+    pending_.get();
+    return true;
+}
+
+}
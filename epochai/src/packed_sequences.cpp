@@ -0,0 +1,29 @@
+#include "epochai/packed_sequences.hpp"
+
+namespace epochai {
+
+void PackedSequences::append(std::span<const TokenId> sequence) {
+    tokens.insert(tokens.end(), sequence.begin(), sequence.end());
+    offsets.push_back(tokens.size());
+}
+
+void PackedSequences::clear() noexcept {
+    tokens.clear();
+    offsets.resize(1);
+    offsets[0] = 0;
+}
+
+PackedSequenceBuilder::PackedSequenceBuilder(Vocabulary& vocab)
+    : vocab_(vocab), eos_id_(vocab.intern(kEosToken)) {}
+
+void PackedSequenceBuilder::on_token(std::string_view token) {
+    open_.push_back(vocab_.intern(token));
+}
+
+void PackedSequenceBuilder::on_line_end() {
+    open_.push_back(eos_id_);
+    batch_.append(open_);
+    open_.clear();
+}
+
+}
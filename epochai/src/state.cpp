@@ -1,60 +1,120 @@
 #include "epochai/state.hpp"
 
 #include "epochai/io_utils.hpp"
+#include "epochai/model_image.hpp"
+#include "epochai/model_journal.hpp"
 #include "epochai/tokenizer.hpp"
 
 #include <algorithm>
 #include <cctype>
 #include <charconv>
 #include <cmath>
+#include <fstream>
+#include <limits>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
-#include <unordered_set>
+#include <utility>
 
 namespace epochai {
 namespace {
 
-constexpr std::string_view kPadToken = "<pad>";
-constexpr std::string_view kEosToken = "<eos>";
+constexpr std::string_view kFallbackDatasetLine = "Learning thrives when curiosity meets practice.";
 
 struct LossComputationResult {
     double loss_sum = 0.0;
     std::size_t count = 0;
 };
 
-LossComputationResult compute_loss_internal(const ModelState& state,
-                                            const std::vector<std::vector<std::string>>& sequences,
-                                            std::size_t vocab_size) {
+/// Invoke `visit(current, next)` for every adjacent pair inside the packed
+/// sequences `[first, last)` and return the number of sequences visited.
+template <typename Visit>
+std::size_t for_each_transition(const PackedSequences& batch, std::size_t first, std::size_t last,
+                                Visit&& visit) {
+    const TokenId* tokens = batch.tokens.data();
+    for (std::size_t s = first; s < last; ++s) {
+        const std::size_t end = batch.offsets[s + 1];
+        for (std::size_t i = batch.offsets[s]; i + 1 < end; ++i) {
+            visit(tokens[i], tokens[i + 1]);
+        }
+    }
+    return last - first;
+}
+
+/// Number of aggregated transitions scored per reduction block. Fixed so the
+/// summation tree is the same for every thread count.
+constexpr std::size_t kLossBlockSize = 4096;
+
+/// Neumaier-compensated running sum.
+struct CompensatedSum {
+    double sum = 0.0;
+    double compensation = 0.0;
+
+    void add(double value) {
+        const double next = sum + value;
+        if (std::abs(sum) >= std::abs(value)) {
+            compensation += (sum - next) + value;
+        } else {
+            compensation += (value - next) + sum;
+        }
+        sum = next;
+    }
+
+    double value() const { return sum + compensation; }
+};
+
+/// Combine `values[first, last)` as a balanced binary tree.
+double pairwise_sum(const std::vector<double>& values, std::size_t first, std::size_t last) {
+    if (last - first == 1) {
+        return values[first];
+    }
+    const std::size_t middle = first + (last - first) / 2;
+    return pairwise_sum(values, first, middle) + pairwise_sum(values, middle, last);
+}
+
+/// Score every aggregated transition against `model`, which provides
+/// `count(prev, next)` and `total(prev)`. Each distinct pair is
+/// looked up once and weighted by its occurrence count, which equals walking
+/// the token stream up to floating-point summation order. Blocks of
+/// `kLossBlockSize` entries are scored independently (in parallel when `pool`
+/// is given) and reduced in block order.
+template <typename Model>
+LossComputationResult compute_loss_internal(const Model& model, const std::vector<TransitionTable::Entry>& entries,
+                                            std::size_t transition_count, std::size_t vocab_size,
+                                            WorkerPool* pool) {
     LossComputationResult result;
     if (vocab_size == 0) {
         return result;
     }
-    for (const auto& seq : sequences) {
-        if (seq.size() < 2) {
-            continue;
-        }
-        for (std::size_t i = 0; i + 1 < seq.size(); ++i) {
-            const auto& current = seq[i];
-            const auto& next = seq[i + 1];
-            if (current == kPadToken || next == kPadToken) {
-                continue;
-            }
+    result.count = transition_count;
+    if (entries.empty()) {
+        return result;
+    }
+    const std::size_t blocks = (entries.size() + kLossBlockSize - 1) / kLossBlockSize;
+    std::vector<double> block_sums(blocks, 0.0);
+    auto score_block = [&](std::size_t block) {
+        const std::size_t first = block * kLossBlockSize;
+        const std::size_t last = std::min(first + kLossBlockSize, entries.size());
+        CompensatedSum loss;
+        for (std::size_t i = first; i < last; ++i) {
+            const auto& entry = entries[i];
             double matched = 1.0; // Laplace smoothing
             double total = static_cast<double>(vocab_size);
-            if (const auto total_it = state.totals.find(current); total_it != state.totals.end()) {
-                total += total_it->second;
-            }
-            if (const auto map_it = state.transitions.find(current); map_it != state.transitions.end()) {
-                if (const auto next_it = map_it->second.find(next); next_it != map_it->second.end()) {
-                    matched += next_it->second;
-                }
-            }
+            total += model.total(entry.prev);
+            matched += model.count(entry.prev, entry.next);
             double probability = matched / total;
-            result.loss_sum -= std::log(probability);
-            result.count += 1;
+            loss.add(-entry.count * std::log(probability));
+        }
+        block_sums[block] = loss.value();
+    };
+    if (pool != nullptr && blocks > 1) {
+        pool->parallel_for(blocks, score_block);
+    } else {
+        for (std::size_t block = 0; block < blocks; ++block) {
+            score_block(block);
         }
     }
+    result.loss_sum = pairwise_sum(block_sums, 0, blocks);
     return result;
 }
 
@@ -65,6 +125,12 @@ void append_default_config(const std::filesystem::path& path) {
     content += "lm_studio_url=http://127.0.0.1:1234/v1/chat/completions\n";
     content += "request_timeout_ms=2000\n";
     content += "retries=2\n";
+    content += "request_deadline_ms=5000\n";
+    content += "worker_threads=0\n";
+    content += "export_text_state=0\n";
+    content += "journal_compact_bytes=67108864\n";
+    content += "checkpoint_interval_steps=1\n";
+    content += "incremental_training=0\n";
     FileIO::atomic_write(path, content);
 }
 
@@ -89,103 +155,43 @@ std::string_view trim(std::string_view text) {
     return text;
 }
 
-} // namespace
-
-StateManager::StateManager(std::filesystem::path root)
-    : root_(std::move(root)) {}
-
-std::filesystem::path StateManager::config_path() const {
-    return root_ / "config.txt";
-}
-
-std::filesystem::path StateManager::dataset_path() const {
-    return root_ / "dataset.txt";
-}
-
-std::filesystem::path StateManager::model_state_path() const {
-    return root_ / "model_state.txt";
-}
-
-std::filesystem::path StateManager::log_path() const {
-    return root_ / "events.log";
-}
-
-TrainingConfig StateManager::load_or_initialize_config() {
-    const auto path = config_path();
-    if (!std::filesystem::exists(path)) {
-        std::filesystem::create_directories(root_);
-        append_default_config(path);
-    }
-    TrainingConfig config;
-    config.mcp_url = "http://127.0.0.1:3333/jsonrpc";
-    config.lm_studio_url = "http://127.0.0.1:1234/v1/chat/completions";
-    config.request_timeout_ms = 2000;
-    config.retries = 2;
-
-    const auto content = FileIO::read_file(path);
-    std::istringstream stream(content);
-    std::string line;
-    while (std::getline(stream, line)) {
-        auto view = trim(line);
-        if (view.empty() || view.front() == '#') {
-            continue;
-        }
-        const auto delimiter = view.find('=');
-        if (delimiter == std::string_view::npos) {
-            continue;
-        }
-        const auto key = view.substr(0, delimiter);
-        const auto value = view.substr(delimiter + 1);
-        if (key == "mcp_url") {
-            config.mcp_url = std::string(value);
-        } else if (key == "lm_studio_url") {
-            config.lm_studio_url = std::string(value);
-        } else if (key == "request_timeout_ms") {
-            int parsed = config.request_timeout_ms;
-            std::from_chars(value.data(), value.data() + value.size(), parsed);
-            config.request_timeout_ms = parsed;
-        } else if (key == "retries") {
-            int parsed = config.retries;
-            std::from_chars(value.data(), value.data() + value.size(), parsed);
-            config.retries = parsed;
-        }
-    }
-    return config;
-}
-
-std::vector<std::string> StateManager::load_or_initialize_dataset() {
-    const auto path = dataset_path();
-    if (!std::filesystem::exists(path)) {
-        std::filesystem::create_directories(root_);
-        append_default_dataset(path);
-    }
-    const auto content = FileIO::read_file(path);
-    std::istringstream stream(content);
-    std::vector<std::string> lines;
-    std::string line;
-    while (std::getline(stream, line)) {
-        if (!line.empty() && (line.back() == '\r')) {
-            line.pop_back();
-        }
-        lines.push_back(line);
-    }
-    if (lines.empty()) {
-        lines.push_back("Learning thrives when curiosity meets practice.");
+/// Render `state` in the legacy text layout. Counts use the shortest
+/// representation that parses back to the same double.
+std::string format_model_state_text(const ModelState& state) {
+    std::string out;
+    char number[32];
+    auto append_number = [&](double value) {
+        const auto result = std::to_chars(number, number + sizeof(number), value);
+        out.append(number, result.ptr);
+    };
+    out += "STEP " + std::to_string(state.step) + "\n";
+    out += "VOCAB " + std::to_string(state.vocab.size()) + "\n";
+    for (const auto& token : state.vocab) {
+        out += token;
+        out += '\n';
     }
-    return lines;
+    out += "TRANSITIONS " + std::to_string(state.transitions.size()) + "\n";
+    state.transitions.for_each([&](const TransitionTable::Entry& entry) {
+        out += state.vocab[entry.prev];
+        out += '\t';
+        out += state.vocab[entry.next];
+        out += '\t';
+        append_number(entry.count);
+        out += '\n';
+    });
+    out += "TOTALS " + std::to_string(state.transitions.row_count()) + "\n";
+    state.transitions.for_each_total([&](TokenId token, double value) {
+        out += state.vocab[token];
+        out += '\t';
+        append_number(value);
+        out += '\n';
+    });
+    return out;
 }
 
-ModelState StateManager::load_or_initialize_model_state() {
-    const auto path = model_state_path();
-    if (!std::filesystem::exists(path)) {
-        std::filesystem::create_directories(root_);
-        ModelState state;
-        ensure_core_tokens(state);
-        save_model_state(state);
-        return state;
-    }
-    const auto content = FileIO::read_file(path);
-    std::istringstream stream(content);
+/// Parse the legacy text layout written by `format_model_state_text`.
+ModelState parse_model_state_text(std::string_view content) {
+    std::istringstream stream{std::string(content)};
     ModelState state;
     std::string line;
 
@@ -220,6 +226,9 @@ ModelState StateManager::load_or_initialize_model_state() {
         if (ec != std::errc()) {
             throw std::runtime_error("Failed to parse VOCAB count");
         }
+        // Rebuild the token index in one pass; duplicate lines collapse to the
+        // first occurrence's id.
+        state.vocab.reserve(static_cast<std::size_t>(std::max(count, 0)));
         for (int i = 0; i < count; ++i) {
             if (!std::getline(stream, line)) {
                 throw std::runtime_error("Unexpected end of vocab entries");
@@ -227,7 +236,7 @@ ModelState StateManager::load_or_initialize_model_state() {
             if (!line.empty() && line.back() == '\r') {
                 line.pop_back();
             }
-            state.vocab.push_back(line);
+            state.vocab.intern(line);
         }
     }
 
@@ -245,6 +254,7 @@ ModelState StateManager::load_or_initialize_model_state() {
         if (ec != std::errc()) {
             throw std::runtime_error("Failed to parse transition count");
         }
+        state.transitions.reserve(static_cast<std::size_t>(std::max(count, 0)));
         for (int i = 0; i < count; ++i) {
             if (!std::getline(stream, line)) {
                 throw std::runtime_error("Unexpected end of transitions");
@@ -271,7 +281,7 @@ ModelState StateManager::load_or_initialize_model_state() {
             } catch (...) {
                 throw std::runtime_error("Failed to parse transition value");
             }
-            state.transitions[current][next] = value;
+            state.transitions.set_count(state.vocab.intern(current), state.vocab.intern(next), value);
         }
     }
 
@@ -311,66 +321,447 @@ ModelState StateManager::load_or_initialize_model_state() {
             } catch (...) {
                 throw std::runtime_error("Failed to parse totals value");
             }
-            state.totals[token] = total;
+            state.transitions.set_total(state.vocab.intern(token), total);
         }
     }
 
+    return state;
+}
+
+} // namespace
+
+StateManager::StateManager(std::filesystem::path root)
+    : root_(std::move(root)) {}
+
+std::filesystem::path StateManager::config_path() const {
+    return root_ / "config.txt";
+}
+
+std::filesystem::path StateManager::dataset_path() const {
+    return root_ / "dataset.txt";
+}
+
+std::filesystem::path StateManager::model_state_path() const {
+    return root_ / "model_state.bin";
+}
+
+std::filesystem::path StateManager::model_state_text_path() const {
+    return root_ / "model_state.txt";
+}
+
+std::filesystem::path StateManager::dataset_watermark_path() const {
+    return root_ / "dataset.watermark";
+}
+
+std::filesystem::path StateManager::token_cache_path() const {
+    return root_ / "dataset.tokens";
+}
+
+std::filesystem::path StateManager::journal_directory() const {
+    return root_ / "journal";
+}
+
+std::filesystem::path StateManager::log_path() const {
+    return root_ / "events.log";
+}
+
+TrainingConfig StateManager::load_or_initialize_config() {
+    const auto path = config_path();
+    if (!std::filesystem::exists(path)) {
+        std::filesystem::create_directories(root_);
+        append_default_config(path);
+    }
+    TrainingConfig config;
+    config.mcp_url = "http://127.0.0.1:3333/jsonrpc";
+    config.lm_studio_url = "http://127.0.0.1:1234/v1/chat/completions";
+    config.request_timeout_ms = 2000;
+    config.retries = 2;
+
+    const auto content = FileIO::read_file(path);
+    std::istringstream stream(content);
+    std::string line;
+    while (std::getline(stream, line)) {
+        auto view = trim(line);
+        if (view.empty() || view.front() == '#') {
+            continue;
+        }
+        const auto delimiter = view.find('=');
+        if (delimiter == std::string_view::npos) {
+            continue;
+        }
+        const auto key = view.substr(0, delimiter);
+        const auto value = view.substr(delimiter + 1);
+        if (key == "mcp_url") {
+            config.mcp_url = std::string(value);
+        } else if (key == "lm_studio_url") {
+            config.lm_studio_url = std::string(value);
+        } else if (key == "request_timeout_ms") {
+            int parsed = config.request_timeout_ms;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            config.request_timeout_ms = parsed;
+        } else if (key == "retries") {
+            int parsed = config.retries;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            config.retries = parsed;
+        } else if (key == "request_deadline_ms") {
+            int parsed = config.request_deadline_ms;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            config.request_deadline_ms = std::max(parsed, 0);
+        } else if (key == "worker_threads") {
+            int parsed = config.worker_threads;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            config.worker_threads = std::max(parsed, 0);
+        } else if (key == "export_text_state") {
+            config.export_text_state = value == "1" || value == "true";
+        } else if (key == "journal_compact_bytes") {
+            std::uint64_t parsed = config.journal_compact_bytes;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            config.journal_compact_bytes = parsed;
+        } else if (key == "checkpoint_interval_steps") {
+            int parsed = config.checkpoint_interval_steps;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            config.checkpoint_interval_steps = std::max(parsed, 1);
+        } else if (key == "incremental_training") {
+            config.incremental_training = value == "1" || value == "true";
+        }
+    }
+    return config;
+}
+
+void StateManager::for_each_dataset_chunk(std::size_t chunk_size,
+                                          const std::function<void(std::string_view)>& on_chunk) {
+    const auto path = dataset_path();
+    if (!std::filesystem::exists(path)) {
+        std::filesystem::create_directories(root_);
+        append_default_dataset(path);
+    }
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+    std::vector<char> buffer(std::max<std::size_t>(1, chunk_size));
+    bool any_data = false;
+    while (stream) {
+        stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        const auto read = static_cast<std::size_t>(stream.gcount());
+        if (read == 0) {
+            break;
+        }
+        any_data = true;
+        on_chunk(std::string_view(buffer.data(), read));
+    }
+    if (stream.bad()) {
+        throw std::runtime_error("Failed to read file: " + path.string());
+    }
+    if (!any_data) {
+        on_chunk(kFallbackDatasetLine);
+    }
+}
+
+void StateManager::for_each_dataset_chunk(std::size_t chunk_size, std::uint64_t begin, std::uint64_t end,
+                                          const std::function<void(std::string_view)>& on_chunk) {
+    const auto path = dataset_path();
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+    stream.seekg(static_cast<std::streamoff>(begin));
+    std::vector<char> buffer(std::max<std::size_t>(1, chunk_size));
+    std::uint64_t position = begin;
+    while (stream && position < end) {
+        const auto wanted = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), end - position));
+        stream.read(buffer.data(), static_cast<std::streamsize>(wanted));
+        const auto read = static_cast<std::size_t>(stream.gcount());
+        if (read == 0) {
+            break;
+        }
+        position += read;
+        on_chunk(std::string_view(buffer.data(), read));
+    }
+    if (stream.bad()) {
+        throw std::runtime_error("Failed to read file: " + path.string());
+    }
+}
+
+std::uint64_t StateManager::dataset_line_end() {
+    const auto path = dataset_path();
+    if (!std::filesystem::exists(path)) {
+        std::filesystem::create_directories(root_);
+        append_default_dataset(path);
+    }
+    std::error_code ec;
+    std::uint64_t end = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return 0;
+    }
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+    constexpr std::size_t kBlockSize = 64 * 1024;
+    std::vector<char> buffer(kBlockSize);
+    while (end > 0) {
+        const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(kBlockSize, end));
+        stream.seekg(static_cast<std::streamoff>(end - size));
+        if (!stream.read(buffer.data(), static_cast<std::streamsize>(size))) {
+            throw std::runtime_error("Failed to read file: " + path.string());
+        }
+        const std::string_view block(buffer.data(), size);
+        if (const auto newline = block.rfind('\n'); newline != std::string_view::npos) {
+            return end - size + newline + 1;
+        }
+        end -= size;
+    }
+    return 0;
+}
+
+std::optional<ContentHasher> StateManager::hash_dataset_prefix(const DatasetWatermark& watermark) {
+    std::error_code ec;
+    if (std::filesystem::file_size(dataset_path(), ec) < watermark.offset || ec) {
+        return std::nullopt;
+    }
+    ContentHasher hasher;
+    for_each_dataset_chunk(std::size_t{1} << 20, 0, watermark.offset,
+                           [&](std::string_view chunk) { hasher.update(chunk); });
+    if (hasher.digest() != watermark.fingerprint) {
+        return std::nullopt;
+    }
+    return hasher;
+}
+
+std::optional<DatasetWatermark> StateManager::load_dataset_watermark() const {
+    const auto content = FileIO::try_read_file(dataset_watermark_path());
+    if (!content) {
+        return std::nullopt;
+    }
+    DatasetWatermark watermark;
+    bool has_offset = false;
+    bool has_fingerprint = false;
+    std::istringstream stream(*content);
+    std::string line;
+    while (std::getline(stream, line)) {
+        const auto view = trim(line);
+        const auto delimiter = view.find('=');
+        if (delimiter == std::string_view::npos) {
+            continue;
+        }
+        const auto key = view.substr(0, delimiter);
+        const auto value = view.substr(delimiter + 1);
+        if (key == "offset") {
+            has_offset = std::from_chars(value.data(), value.data() + value.size(), watermark.offset).ec == std::errc();
+        } else if (key == "fingerprint") {
+            has_fingerprint =
+                std::from_chars(value.data(), value.data() + value.size(), watermark.fingerprint, 16).ec == std::errc();
+        }
+    }
+    if (!has_offset || !has_fingerprint) {
+        return std::nullopt;
+    }
+    return watermark;
+}
+
+void StateManager::save_dataset_watermark(const DatasetWatermark& watermark) {
+    std::string content;
+    content += "offset=" + std::to_string(watermark.offset) + "\n";
+    content += "fingerprint=" + to_hex(watermark.fingerprint) + "\n";
+    FileIO::atomic_write(dataset_watermark_path(), content);
+}
+
+std::optional<MappedTokenCache> StateManager::open_token_cache() {
+    std::error_code ec;
+    if (!std::filesystem::exists(token_cache_path(), ec)) {
+        return std::nullopt;
+    }
+    std::optional<MappedTokenCache> cache;
+    try {
+        cache.emplace(token_cache_path());
+    } catch (const std::exception&) {
+        // A cache that cannot be read is simply rebuilt.
+        return std::nullopt;
+    }
+    const auto dataset_bytes = std::filesystem::file_size(dataset_path(), ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    if (dataset_bytes == 0) {
+        // An empty dataset is streamed as the fallback line, so the cache is
+        // keyed on that line rather than on the file.
+        if (cache->dataset_bytes() != kFallbackDatasetLine.size() ||
+            cache->fingerprint() != content_hash(kFallbackDatasetLine)) {
+            return std::nullopt;
+        }
+        return cache;
+    }
+    if (dataset_bytes != cache->dataset_bytes() ||
+        !hash_dataset_prefix(DatasetWatermark{dataset_bytes, cache->fingerprint()})) {
+        return std::nullopt;
+    }
+    return cache;
+}
+
+std::optional<ModelState> StateManager::load_model_snapshot() const {
+    if (auto image = FileIO::try_read_file(model_state_path())) {
+        return decode_model_image(*image);
+    }
+    if (auto text = FileIO::try_read_file(model_state_text_path())) {
+        return parse_model_state_text(*text);
+    }
+    return std::nullopt;
+}
+
+ModelState StateManager::load_or_initialize_model_state() {
+    const bool has_image = std::filesystem::exists(model_state_path());
+    auto snapshot = load_model_snapshot();
+    if (!snapshot) {
+        std::filesystem::create_directories(root_);
+        ModelState state;
+        ensure_core_tokens(state);
+        save_model_state(state);
+        return state;
+    }
+    ModelState state = std::move(*snapshot);
+    ModelJournal journal(journal_directory());
+    journal.replay(state, journal.segments());
+
+    // Journal records continue the persisted vocabulary, so tokens added here
+    // and a legacy text snapshot are written out as a fresh image right away.
+    const std::size_t persisted_vocab = state.vocab.size();
     ensure_core_tokens(state);
+    if (!has_image || state.vocab.size() != persisted_vocab) {
+        save_model_state(state);
+    }
     return state;
 }
 
+std::optional<ModelState> StateManager::read_model_state() const {
+    const ModelJournal journal(journal_directory());
+    for (int attempt = 0;; ++attempt) {
+        try {
+            auto state = load_model_snapshot();
+            if (state) {
+                journal.replay(*state, journal.segments(), false);
+            }
+            return state;
+        } catch (const std::exception&) {
+            // A concurrent compaction may delete segments between listing and
+            // reading them; they are in the new snapshot by then, so retry.
+            if (attempt == 2) {
+                throw;
+            }
+        }
+    }
+}
+
 void StateManager::save_model_state(const ModelState& state) {
-    std::ostringstream oss;
-    oss << "STEP " << state.step << "\n";
-    oss << "VOCAB " << state.vocab.size() << "\n";
-    for (const auto& token : state.vocab) {
-        oss << token << "\n";
+    FileIO::atomic_write(model_state_path(), encode_model_image(state));
+    for (const auto& segment : ModelJournal(journal_directory()).segments()) {
+        std::filesystem::remove(segment);
+    }
+}
+
+void StateManager::append_model_delta(const ModelDelta& delta) {
+    ModelJournal(journal_directory()).append(delta);
+}
+
+std::uintmax_t StateManager::model_journal_bytes() const {
+    return ModelJournal(journal_directory()).size_bytes();
+}
+
+std::vector<std::filesystem::path> StateManager::seal_model_journal() {
+    return ModelJournal(journal_directory()).seal();
+}
+
+void StateManager::compact_model_journal(const std::vector<std::filesystem::path>& sealed) {
+    auto snapshot = load_model_snapshot();
+    if (!snapshot) {
+        throw std::runtime_error("Cannot compact the journal without a model snapshot");
     }
-    std::size_t transition_count = 0;
-    for (const auto& [_, inner] : state.transitions) {
-        transition_count += inner.size();
+    ModelJournal(journal_directory()).replay(*snapshot, sealed);
+    FileIO::atomic_write(model_state_path(), encode_model_image(*snapshot));
+    // Records are skipped by step on replay, so a crash before these removals
+    // only leaves redundant segments behind.
+    for (const auto& segment : sealed) {
+        std::filesystem::remove(segment);
     }
-    oss << "TRANSITIONS " << transition_count << "\n";
-    for (const auto& [current, inner] : state.transitions) {
-        for (const auto& [next, value] : inner) {
-            oss << current << '\t' << next << '\t' << value << "\n";
-        }
+}
+
+void StateManager::export_model_state_text(const ModelState& state) {
+    FileIO::atomic_write(model_state_text_path(), format_model_state_text(state));
+}
+
+void TransitionCounts::add(const PackedSequences& batch) {
+    add(batch, 0, batch.sequence_count());
+}
+
+void TransitionCounts::add(const PackedSequences& batch, std::size_t first, std::size_t last) {
+    sequence_count += for_each_transition(batch, first, last, [&](TokenId current, TokenId next) {
+        pairs.increment(current, next);
+        transition_count += 1;
+    });
+}
+
+void TransitionCounts::merge(const TransitionCounts& other) {
+    other.pairs.for_each([&](const TransitionTable::Entry& entry) {
+        pairs.increment(entry.prev, entry.next, entry.count);
+    });
+    transition_count += other.transition_count;
+    sequence_count += other.sequence_count;
+}
+
+ShardedTransitionCounter::ShardedTransitionCounter(WorkerPool& pool)
+    : pool_(pool), shards_(pool.size()) {}
+
+void ShardedTransitionCounter::add(const PackedSequences& batch) {
+    const std::size_t sequences = batch.sequence_count();
+    // Below this many tokens per shard the fan-out costs more than it saves.
+    constexpr std::size_t kMinTokensPerShard = 16 * 1024;
+    const std::size_t max_shards = std::max<std::size_t>(std::min(shards_.size(), sequences), 1);
+    const std::size_t shard_count =
+        std::clamp<std::size_t>(batch.tokens.size() / kMinTokensPerShard, 1, max_shards);
+    if (shard_count == 1) {
+        shards_[0].add(batch);
+        return;
     }
-    oss << "TOTALS " << state.totals.size() << "\n";
-    for (const auto& [token, value] : state.totals) {
-        oss << token << '\t' << value << "\n";
+    // Split at token quantiles so shards carry similar work.
+    std::vector<std::size_t> bounds(shard_count + 1, sequences);
+    bounds[0] = 0;
+    for (std::size_t k = 1; k < shard_count; ++k) {
+        const std::size_t target = batch.tokens.size() * k / shard_count;
+        const auto it = std::upper_bound(batch.offsets.begin(), batch.offsets.end() - 1, target);
+        bounds[k] = std::max(bounds[k - 1], static_cast<std::size_t>(it - batch.offsets.begin()) - 1);
     }
-    FileIO::atomic_write(model_state_path(), oss.str());
+    pool_.parallel_for(shard_count, [&](std::size_t shard) {
+        shards_[shard].add(batch, bounds[shard], bounds[shard + 1]);
+    });
 }
 
-TrainingStats train_one_step(ModelState& state, const std::vector<std::vector<std::string>>& sequences,
-                              std::size_t vocab_size) {
+TransitionCounts ShardedTransitionCounter::take() {
+    TransitionCounts merged = std::move(shards_[0]);
+    for (std::size_t shard = 1; shard < shards_.size(); ++shard) {
+        merged.merge(shards_[shard]);
+    }
+    shards_.assign(shards_.size(), TransitionCounts{});
+    return merged;
+}
+
+TrainingStats train_one_step(ModelState& state, const TransitionCounts& counts, std::size_t vocab_size,
+                             WorkerPool* pool) {
     TrainingStats stats;
-    stats.sequence_count = sequences.size();
-    const auto before = compute_loss_internal(state, sequences, vocab_size);
+    stats.sequence_count = counts.sequence_count;
+    const auto entries = counts.pairs.sorted_entries();
+    const auto before = compute_loss_internal(state.transitions, entries, counts.transition_count, vocab_size, pool);
     if (before.count > 0) {
         stats.loss_before = before.loss_sum / static_cast<double>(before.count);
     }
     stats.token_count = before.count;
 
-    for (const auto& seq : sequences) {
-        if (seq.size() < 2) {
-            continue;
-        }
-        for (std::size_t i = 0; i + 1 < seq.size(); ++i) {
-            const auto& current = seq[i];
-            const auto& next = seq[i + 1];
-            if (current == kPadToken || next == kPadToken) {
-                continue;
-            }
-            state.transitions[current][next] += 1.0;
-            state.totals[current] += 1.0;
-        }
+    for (const auto& entry : entries) {
+        state.transitions.increment(entry.prev, entry.next, entry.count);
     }
 
     state.step += 1;
 
-    const auto after = compute_loss_internal(state, sequences, vocab_size);
+    const auto after = compute_loss_internal(state.transitions, entries, counts.transition_count, vocab_size, pool);
     if (after.count > 0) {
         stats.loss_after = after.loss_sum / static_cast<double>(after.count);
         stats.perplexity = std::exp(stats.loss_after);
@@ -378,10 +769,11 @@ TrainingStats train_one_step(ModelState& state, const std::vector<std::vector<st
     return stats;
 }
 
-EvaluationStats evaluate_model(const ModelState& state, const std::vector<std::vector<std::string>>& sequences,
-                               std::size_t vocab_size) {
+EvaluationStats evaluate_model(const ModelState& state, const TransitionCounts& counts, std::size_t vocab_size,
+                               WorkerPool* pool) {
     EvaluationStats stats;
-    const auto result = compute_loss_internal(state, sequences, vocab_size);
+    const auto result =
+        compute_loss_internal(state.transitions, counts.pairs.sorted_entries(), counts.transition_count, vocab_size, pool);
     if (result.count > 0) {
         stats.loss = result.loss_sum / static_cast<double>(result.count);
         stats.perplexity = std::exp(stats.loss);
@@ -389,22 +781,41 @@ EvaluationStats evaluate_model(const ModelState& state, const std::vector<std::v
     return stats;
 }
 
-void ensure_core_tokens(ModelState& state) {
-    if (std::find(state.vocab.begin(), state.vocab.end(), kPadToken) == state.vocab.end()) {
-        state.vocab.emplace_back(kPadToken);
+EvaluationStats evaluate_model(const MappedModel& model, const Vocabulary& vocab, const TransitionCounts& counts,
+                               WorkerPool* pool) {
+    // Translate caller ids to image ids once; ids unknown to the image map
+    // past its vocabulary, where counts and totals are zero.
+    constexpr TokenId kUnmapped = std::numeric_limits<TokenId>::max();
+    std::vector<TokenId> image_ids(vocab.size(), kUnmapped);
+    std::size_t vocab_size = model.vocab_size();
+    for (std::size_t id = 0; id < vocab.size(); ++id) {
+        if (const auto image_id = model.find(vocab[static_cast<TokenId>(id)])) {
+            image_ids[id] = *image_id;
+        } else {
+            vocab_size += 1;
+        }
     }
-    if (std::find(state.vocab.begin(), state.vocab.end(), kEosToken) == state.vocab.end()) {
-        state.vocab.emplace_back(kEosToken);
+    struct RemappedModel {
+        const MappedModel& model;
+        const std::vector<TokenId>& image_ids;
+
+        double count(TokenId prev, TokenId next) const { return model.count(image_ids[prev], image_ids[next]); }
+        double total(TokenId prev) const { return model.total(image_ids[prev]); }
+    };
+
+    EvaluationStats stats;
+    const auto result = compute_loss_internal(RemappedModel{model, image_ids}, counts.pairs.sorted_entries(),
+                                              counts.transition_count, vocab_size, pool);
+    if (result.count > 0) {
+        stats.loss = result.loss_sum / static_cast<double>(result.count);
+        stats.perplexity = std::exp(stats.loss);
     }
+    return stats;
 }
 
-void update_vocab(ModelState& state, const std::vector<std::string>& tokens) {
-    std::unordered_set<std::string> existing(state.vocab.begin(), state.vocab.end());
-    for (const auto& token : tokens) {
-        if (existing.insert(token).second) {
-            state.vocab.push_back(token);
-        }
-    }
+void ensure_core_tokens(ModelState& state) {
+    state.vocab.intern(kPadToken);
+    state.vocab.intern(kEosToken);
 }
 
 }
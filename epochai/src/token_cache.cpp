@@ -0,0 +1,183 @@
+#include "epochai/token_cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace epochai {
+namespace {
+
+static_assert(std::endian::native == std::endian::little, "token caches are little-endian");
+
+constexpr char kTokenCacheMagic[8] = {'E', 'P', 'A', 'I', 'T', 'O', 'K', '\0'};
+
+constexpr std::size_t align8(std::size_t value) {
+    return (value + 7) & ~std::size_t{7};
+}
+
+template <typename T>
+void append_values(AtomicFileWriter& file, const std::vector<T>& values) {
+    file.append({reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)});
+}
+
+template <typename T>
+std::span<const T> section(std::string_view image, std::size_t offset, std::size_t count) {
+    return {reinterpret_cast<const T*>(image.data() + offset), count};
+}
+
+/// Ensure `offsets` starts at 0, never decreases and ends at `limit`.
+void check_offsets(std::span<const std::uint64_t> offsets, std::uint64_t limit, const char* what) {
+    if (offsets.front() != 0 || offsets.back() != limit ||
+        std::adjacent_find(offsets.begin(), offsets.end(), std::greater<>()) != offsets.end()) {
+        throw std::runtime_error(std::string("Token cache has malformed ") + what);
+    }
+}
+
+} // namespace
+
+TokenCacheBuilder::TokenCacheBuilder(const Vocabulary& vocab, const std::filesystem::path& path)
+    : vocab_(vocab), file_(path) {
+    const auto eos = vocab_.find(kEosToken);
+    if (!eos) {
+        throw std::runtime_error("Token cache vocabulary lacks <eos>");
+    }
+    local_id(*eos);
+    // The header is written last, once the section sizes are known.
+    file_.append(std::string(sizeof(TokenCacheHeader), '\0'));
+}
+
+TokenId TokenCacheBuilder::local_id(TokenId id) {
+    if (id >= local_of_.size()) {
+        local_of_.resize(std::max<std::size_t>(vocab_.size(), std::size_t{id} + 1), 0);
+    }
+    if (local_of_[id] == 0) {
+        locals_.push_back(id);
+        local_of_[id] = static_cast<TokenId>(locals_.size());
+    }
+    return local_of_[id] - 1;
+}
+
+void TokenCacheBuilder::pad_to_alignment() {
+    const auto padding = align8(static_cast<std::size_t>(file_.size())) - static_cast<std::size_t>(file_.size());
+    file_.append(std::string(padding, '\0'));
+}
+
+void TokenCacheBuilder::add(const PackedSequences& batch) {
+    batch_locals_.clear();
+    for (const TokenId id : batch.tokens) {
+        batch_locals_.push_back(local_id(id));
+    }
+    append_values(file_, batch_locals_);
+    const std::uint64_t start = offsets_.back();
+    for (std::size_t i = 1; i < batch.offsets.size(); ++i) {
+        offsets_.push_back(start + batch.offsets[i]);
+    }
+}
+
+void TokenCacheBuilder::finish(std::uint64_t dataset_bytes, std::uint64_t fingerprint,
+                               const CountMetrics& metrics) {
+    TokenCacheHeader header{};
+    std::memcpy(header.magic, kTokenCacheMagic, sizeof(header.magic));
+    header.version = kTokenCacheVersion;
+    header.header_size = sizeof(TokenCacheHeader);
+    header.dataset_bytes = dataset_bytes;
+    header.fingerprint = fingerprint;
+    header.token_count = offsets_.back();
+    header.sequence_count = offsets_.size() - 1;
+    header.vocab_size = locals_.size();
+    header.metric_tokens = metrics.tokens;
+    header.metric_words = metrics.word_count;
+    header.metric_letters = metrics.total_letters;
+
+    std::vector<std::uint64_t> vocab_offsets(locals_.size() + 1, 0);
+    for (std::size_t i = 0; i < locals_.size(); ++i) {
+        vocab_offsets[i + 1] = vocab_offsets[i] + vocab_[locals_[i]].size();
+    }
+    header.string_bytes = vocab_offsets.back();
+
+    pad_to_alignment();
+    append_values(file_, offsets_);
+    append_values(file_, vocab_offsets);
+    for (const TokenId id : locals_) {
+        file_.append(vocab_[id]);
+    }
+    pad_to_alignment();
+    file_.write_at(0, {reinterpret_cast<const char*>(&header), sizeof(header)});
+    file_.commit();
+}
+
+MappedTokenCache::MappedTokenCache(const std::filesystem::path& path)
+    : file_(path) {
+    const auto image = file_.bytes();
+    if (image.size() < sizeof(TokenCacheHeader)) {
+        throw std::runtime_error("Token cache is truncated");
+    }
+    std::memcpy(&header_, image.data(), sizeof(header_));
+    if (std::memcmp(header_.magic, kTokenCacheMagic, sizeof(header_.magic)) != 0) {
+        throw std::runtime_error("Token cache has an unknown format");
+    }
+    if (header_.version != kTokenCacheVersion || header_.header_size != sizeof(TokenCacheHeader)) {
+        throw std::runtime_error("Token cache version is not supported");
+    }
+    // Every count is bounded by the file size before it is used in offset
+    // arithmetic, so a corrupt header cannot overflow the layout below.
+    const std::uint64_t limit = image.size();
+    if (header_.token_count > limit / sizeof(TokenId) || header_.sequence_count >= limit / sizeof(std::uint64_t) ||
+        header_.vocab_size >= limit / sizeof(std::uint64_t) || header_.string_bytes > limit ||
+        header_.vocab_size > std::numeric_limits<TokenId>::max()) {
+        throw std::runtime_error("Token cache is truncated");
+    }
+    const std::size_t tokens_at = sizeof(TokenCacheHeader);
+    const std::size_t offsets_at = align8(tokens_at + header_.token_count * sizeof(TokenId));
+    const std::size_t vocab_at = offsets_at + (header_.sequence_count + 1) * sizeof(std::uint64_t);
+    const std::size_t strings_at = vocab_at + (header_.vocab_size + 1) * sizeof(std::uint64_t);
+    if (strings_at + header_.string_bytes > image.size()) {
+        throw std::runtime_error("Token cache is truncated");
+    }
+    tokens_ = section<TokenId>(image, tokens_at, header_.token_count);
+    offsets_ = section<std::uint64_t>(image, offsets_at, header_.sequence_count + 1);
+    vocab_offsets_ = section<std::uint64_t>(image, vocab_at, header_.vocab_size + 1);
+    strings_ = image.substr(strings_at, header_.string_bytes);
+
+    check_offsets(offsets_, header_.token_count, "sequence offsets");
+    check_offsets(vocab_offsets_, header_.string_bytes, "vocabulary offsets");
+    const auto vocab_size = static_cast<TokenId>(header_.vocab_size);
+    if (std::any_of(tokens_.begin(), tokens_.end(), [&](TokenId id) { return id >= vocab_size; })) {
+        throw std::runtime_error("Token cache references an unknown token");
+    }
+}
+
+CountMetrics MappedTokenCache::metrics() const {
+    CountMetrics metrics;
+    metrics.tokens = header_.metric_tokens;
+    metrics.word_count = header_.metric_words;
+    metrics.total_letters = header_.metric_letters;
+    return metrics;
+}
+
+void MappedTokenCache::replay(Vocabulary& vocab, std::size_t batch_tokens,
+                              const std::function<void(const PackedSequences&)>& on_batch) const {
+    std::vector<TokenId> remap(vocab_offsets_.size() - 1);
+    for (std::size_t i = 0; i < remap.size(); ++i) {
+        remap[i] = vocab.intern(strings_.substr(vocab_offsets_[i], vocab_offsets_[i + 1] - vocab_offsets_[i]));
+    }
+    PackedSequences batch;
+    for (std::size_t s = 0; s < sequence_count(); ++s) {
+        for (std::uint64_t t = offsets_[s]; t < offsets_[s + 1]; ++t) {
+            batch.tokens.push_back(remap[tokens_[t]]);
+        }
+        batch.offsets.push_back(batch.tokens.size());
+        if (batch.tokens.size() >= batch_tokens) {
+            on_batch(batch);
+            batch.clear();
+        }
+    }
+    if (batch.sequence_count() > 0) {
+        on_batch(batch);
+    }
+}
+
+}
@@ -1,34 +1,239 @@
 #include "epochai/tokenizer.hpp"
 
-#include <cctype>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EPOCHAI_TOKENIZER_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define EPOCHAI_TARGET_AVX2
+#else
+#define EPOCHAI_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
 
 namespace epochai {
+namespace {
 
-std::vector<std::string> tokenize(std::string_view text) {
-    std::vector<std::string> tokens;
-    std::string current;
+constexpr std::uint8_t kSpaceClass = 0x1;
+constexpr std::uint8_t kPunctClass = 0x2;
+
+// Mirrors `std::isspace` / `std::ispunct` in the "C" locale, which is the only
+// locale EpochAI runs under. Bytes >= 0x80 belong to neither class, so UTF-8
+// sequences stay inside word tokens.
+constexpr std::array<std::uint8_t, 256> make_char_classes() {
+    std::array<std::uint8_t, 256> classes{};
+    for (int ch = 0x09; ch <= 0x0D; ++ch) {
+        classes[ch] = kSpaceClass;
+    }
+    classes[' '] = kSpaceClass;
+    for (int ch = 0x21; ch <= 0x7E; ++ch) {
+        const bool digit = ch >= '0' && ch <= '9';
+        const bool upper = ch >= 'A' && ch <= 'Z';
+        const bool lower = ch >= 'a' && ch <= 'z';
+        if (!digit && !upper && !lower) {
+            classes[ch] = kPunctClass;
+        }
+    }
+    return classes;
+}
+
+constexpr auto kCharClasses = make_char_classes();
+
+constexpr std::uint8_t char_class(char ch) {
+    return kCharClasses[static_cast<unsigned char>(ch)];
+}
+
+/// Returns the index of the first space or punctuation byte at or after `pos`,
+/// or `size` when the remainder of the buffer is a single word.
+using FindDelimiterFn = std::size_t (*)(const char* data, std::size_t size, std::size_t pos);
+
+std::size_t find_delimiter_scalar(const char* data, std::size_t size, std::size_t pos) {
+    while (pos < size && char_class(data[pos]) == 0) {
+        ++pos;
+    }
+    return pos;
+}
+
+#ifdef EPOCHAI_TOKENIZER_SSE2
+
+// Delimiters occupy five contiguous ASCII ranges: \t-\r, ' '-'/', ':'-'@',
+// '['-'`' and '{'-'~'. Signed byte compares reject everything >= 0x80 for free.
+inline __m128i in_range_sse2(__m128i bytes, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                         _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+std::size_t find_delimiter_sse2(const char* data, std::size_t size, std::size_t pos) {
+    while (pos + 16 <= size) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i hits = in_range_sse2(bytes, 0x09, 0x0D);
+        hits = _mm_or_si128(hits, in_range_sse2(bytes, 0x20, 0x2F));
+        hits = _mm_or_si128(hits, in_range_sse2(bytes, 0x3A, 0x40));
+        hits = _mm_or_si128(hits, in_range_sse2(bytes, 0x5B, 0x60));
+        hits = _mm_or_si128(hits, in_range_sse2(bytes, 0x7B, 0x7E));
+        const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+        if (mask != 0) {
+            return pos + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+        pos += 16;
+    }
+    return find_delimiter_scalar(data, size, pos);
+}
+
+EPOCHAI_TARGET_AVX2 inline __m256i in_range_avx2(__m256i bytes, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), bytes));
+}
 
-    auto flush_current = [&]() {
-        if (!current.empty()) {
-            tokens.push_back(current);
-            current.clear();
+EPOCHAI_TARGET_AVX2 std::size_t find_delimiter_avx2(const char* data, std::size_t size, std::size_t pos) {
+    while (pos + 32 <= size) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i hits = in_range_avx2(bytes, 0x09, 0x0D);
+        hits = _mm256_or_si256(hits, in_range_avx2(bytes, 0x20, 0x2F));
+        hits = _mm256_or_si256(hits, in_range_avx2(bytes, 0x3A, 0x40));
+        hits = _mm256_or_si256(hits, in_range_avx2(bytes, 0x5B, 0x60));
+        hits = _mm256_or_si256(hits, in_range_avx2(bytes, 0x7B, 0x7E));
+        const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask != 0) {
+            return pos + static_cast<std::size_t>(std::countr_zero(mask));
         }
-    };
+        pos += 32;
+    }
+    return find_delimiter_sse2(data, size, pos);
+}
+
+bool cpu_supports_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4] = {};
+    __cpuid(regs, 1);
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+struct TokenizerKernel {
+    FindDelimiterFn find_delimiter;
+    std::string_view name;
+};
+
+TokenizerKernel select_kernel() {
+#ifdef EPOCHAI_TOKENIZER_SSE2
+    if (cpu_supports_avx2()) {
+        return {find_delimiter_avx2, "avx2"};
+    }
+    return {find_delimiter_sse2, "sse2"};
+#else
+    return {find_delimiter_scalar, "scalar"};
+#endif
+}
+
+const TokenizerKernel& active_kernel() {
+    static const TokenizerKernel kernel = select_kernel();
+    return kernel;
+}
 
-    for (char ch : text) {
-        if (std::isspace(static_cast<unsigned char>(ch))) {
-            flush_current();
+template <typename Emit>
+void scan_tokens(std::string_view text, FindDelimiterFn find_delimiter, Emit&& emit) {
+    const char* data = text.data();
+    const std::size_t size = text.size();
+    std::size_t pos = 0;
+    while (pos < size) {
+        const auto cls = char_class(data[pos]);
+        if (cls & kSpaceClass) {
+            ++pos;
             continue;
         }
-        if (std::ispunct(static_cast<unsigned char>(ch))) {
-            flush_current();
-            tokens.emplace_back(1, ch);
+        if (cls & kPunctClass) {
+            emit(text.substr(pos, 1));
+            ++pos;
             continue;
         }
-        current.push_back(ch);
+        const std::size_t end = find_delimiter(data, size, pos + 1);
+        emit(text.substr(pos, end - pos));
+        pos = end;
     }
-    flush_current();
+}
+
+} // namespace
+
+std::vector<std::string> tokenize(std::string_view text) {
+    std::vector<std::string> tokens;
+    scan_tokens(text, active_kernel().find_delimiter, [&](std::string_view token) { tokens.emplace_back(token); });
     return tokens;
 }
 
+void StreamingTokenizer::feed(std::string_view chunk, TokenSink& sink) {
+    const auto find_delimiter = active_kernel().find_delimiter;
+    const auto emit = [&](std::string_view token) { sink.on_token(token); };
+    while (!chunk.empty()) {
+        line_open_ = true;
+        const auto newline = chunk.find('\n');
+        const bool line_complete = newline != std::string_view::npos;
+        auto segment = line_complete ? chunk.substr(0, newline) : chunk;
+        chunk = line_complete ? chunk.substr(newline + 1) : std::string_view{};
+
+        if (!partial_.empty()) {
+            // The previous chunk ended mid-word; extend it up to the first
+            // delimiter of this segment.
+            const std::size_t end = find_delimiter(segment.data(), segment.size(), 0);
+            partial_.append(segment.data(), end);
+            segment.remove_prefix(end);
+            if (segment.empty() && !line_complete) {
+                continue;
+            }
+            joined_.swap(partial_);
+            partial_.clear();
+            emit(joined_);
+        }
+
+        // A word touching the end of an unterminated segment may continue in
+        // the next chunk, so hold it back instead of emitting it.
+        std::string_view tail;
+        if (!line_complete && !segment.empty() && char_class(segment.back()) == 0) {
+            std::size_t start = segment.size();
+            while (start > 0 && char_class(segment[start - 1]) == 0) {
+                --start;
+            }
+            tail = segment.substr(start);
+            segment = segment.substr(0, start);
+        }
+        scan_tokens(segment, find_delimiter, emit);
+        if (!tail.empty()) {
+            partial_.assign(tail);
+        }
+        if (line_complete) {
+            sink.on_line_end();
+            line_open_ = false;
+        }
+    }
+}
+
+void StreamingTokenizer::finish(TokenSink& sink) {
+    if (!partial_.empty()) {
+        joined_.swap(partial_);
+        partial_.clear();
+        sink.on_token(joined_);
+    }
+    if (line_open_) {
+        sink.on_line_end();
+        line_open_ = false;
+    }
+}
+
+std::string_view tokenizer_kernel_name() {
+    return active_kernel().name;
+}
+
 }
@@ -0,0 +1,134 @@
+#include "epochai/transition_table.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace epochai {
+namespace {
+
+constexpr std::size_t kMinCapacity = 16;
+
+constexpr std::uint64_t pack_key(TokenId prev, TokenId next) {
+    return (static_cast<std::uint64_t>(prev) << 32) | next;
+}
+
+// Murmur3 finalizer: spreads both halves of the key over the low bits used to
+// select a bucket.
+constexpr std::uint64_t mix_key(std::uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+} // namespace
+
+double TransitionTable::count(TokenId prev, TokenId next) const noexcept {
+    if (slots_.empty()) {
+        return 0.0;
+    }
+    const std::uint64_t key = pack_key(prev, next);
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t index = mix_key(key) & mask;; index = (index + 1) & mask) {
+        const auto& slot = slots_[index];
+        if (slot.key == key) {
+            return slot.count;
+        }
+        if (slot.key == kEmptyKey) {
+            return 0.0;
+        }
+    }
+}
+
+double TransitionTable::total(TokenId prev) const noexcept {
+    return prev < totals_.size() ? totals_[prev] : 0.0;
+}
+
+void TransitionTable::increment(TokenId prev, TokenId next, double delta) {
+    slot_for(pack_key(prev, next)) += delta;
+    if (prev >= totals_.size()) {
+        totals_.resize(static_cast<std::size_t>(prev) + 1, 0.0);
+    }
+    totals_[prev] += delta;
+}
+
+void TransitionTable::set_count(TokenId prev, TokenId next, double value) {
+    slot_for(pack_key(prev, next)) = value;
+}
+
+void TransitionTable::set_total(TokenId prev, double value) {
+    if (prev >= totals_.size()) {
+        totals_.resize(static_cast<std::size_t>(prev) + 1, 0.0);
+    }
+    totals_[prev] = value;
+}
+
+std::size_t TransitionTable::row_count() const noexcept {
+    std::size_t rows = 0;
+    for (double total : totals_) {
+        rows += total != 0.0 ? 1 : 0;
+    }
+    return rows;
+}
+
+std::vector<TransitionTable::Entry> TransitionTable::sorted_entries() const {
+    std::vector<Entry> entries;
+    entries.reserve(size_);
+    for_each([&](const Entry& entry) { entries.push_back(entry); });
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+        return lhs.prev != rhs.prev ? lhs.prev < rhs.prev : lhs.next < rhs.next;
+    });
+    return entries;
+}
+
+void TransitionTable::reserve(std::size_t entries) {
+    // Keep the load factor at or below 1/2 after reserving.
+    const std::size_t wanted = std::bit_ceil(std::max(kMinCapacity, entries * 2));
+    if (wanted > slots_.size()) {
+        rehash(wanted);
+    }
+}
+
+double& TransitionTable::slot_for(std::uint64_t key) {
+    if (key == kEmptyKey) {
+        throw std::invalid_argument("TransitionTable: reserved token id");
+    }
+    // Grow past a 3/4 load factor to keep linear probe sequences short.
+    if (slots_.empty() || (size_ + 1) * 4 > slots_.size() * 3) {
+        rehash(slots_.empty() ? kMinCapacity : slots_.size() * 2);
+    }
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t index = mix_key(key) & mask;; index = (index + 1) & mask) {
+        auto& slot = slots_[index];
+        if (slot.key == key) {
+            return slot.count;
+        }
+        if (slot.key == kEmptyKey) {
+            slot.key = key;
+            slot.count = 0.0;
+            ++size_;
+            return slot.count;
+        }
+    }
+}
+
+void TransitionTable::rehash(std::size_t capacity) {
+    std::vector<Slot> old = std::move(slots_);
+    slots_.assign(capacity, Slot{kEmptyKey, 0.0});
+    const std::size_t mask = capacity - 1;
+    for (const auto& slot : old) {
+        if (slot.key == kEmptyKey) {
+            continue;
+        }
+        std::size_t index = mix_key(slot.key) & mask;
+        while (slots_[index].key != kEmptyKey) {
+            index = (index + 1) & mask;
+        }
+        slots_[index] = slot;
+    }
+}
+
+}
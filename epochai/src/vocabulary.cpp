@@ -0,0 +1,33 @@
+#include "epochai/vocabulary.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace epochai {
+
+TokenId Vocabulary::intern(std::string_view token) {
+    if (const auto it = index_.find(token); it != index_.end()) {
+        return it->second;
+    }
+    if (tokens_.size() >= std::numeric_limits<TokenId>::max()) {
+        throw std::length_error("Vocabulary exceeds TokenId range");
+    }
+    const auto id = static_cast<TokenId>(tokens_.size());
+    tokens_.emplace_back(token);
+    index_.emplace(tokens_.back(), id);
+    return id;
+}
+
+std::optional<TokenId> Vocabulary::find(std::string_view token) const {
+    if (const auto it = index_.find(token); it != index_.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+void Vocabulary::reserve(std::size_t count) {
+    tokens_.reserve(count);
+    index_.reserve(count);
+}
+
+}
@@ -0,0 +1,100 @@
+#include "epochai/worker_pool.hpp"
+
+#include <algorithm>
+
+namespace epochai {
+
+WorkerPool::WorkerPool(std::size_t threads) {
+    if (threads == 0) {
+        threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(threads - 1);
+    for (std::size_t i = 1; i < threads; ++i) {
+        workers_.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkerPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (workers_.empty() || count == 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        job_ = &fn;
+        job_count_ = count;
+        next_index_.store(0, std::memory_order_relaxed);
+        busy_workers_ = workers_.size();
+        error_ = nullptr;
+        ++generation_;
+    }
+    wake_.notify_all();
+    run_indices();
+
+    std::exception_ptr error;
+    {
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this]() { return busy_workers_ == 0; });
+        job_ = nullptr;
+        error = error_;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::worker_loop() {
+    std::uint64_t seen_generation = 0;
+    for (;;) {
+        {
+            std::unique_lock lock(mutex_);
+            wake_.wait(lock, [&]() { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+        run_indices();
+        {
+            std::lock_guard lock(mutex_);
+            if (--busy_workers_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+}
+
+void WorkerPool::run_indices() {
+    for (;;) {
+        const std::size_t index = next_index_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= job_count_) {
+            return;
+        }
+        try {
+            (*job_)(index);
+        } catch (...) {
+            std::lock_guard lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+}